@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+
+#include <csv/csv.hpp>
+#include <csv/block_reader.hpp>
+#include <csv/prefetch_reader.hpp>
+#include <csv/writer.hpp>
+
+using namespace csv;
+
+namespace {
+
+// Deterministic synthetic csv content: the same arguments always produce the same bytes.
+std::string generate(std::size_t columns, std::size_t field_width, char delimiter, std::size_t size) {
+  std::mt19937_64 random(columns * 1000003 + field_width);
+  std::string content;
+  content.reserve(size + columns * (field_width * 2 + 1));
+  while(content.size() < size){
+    for(std::size_t column = 0; column < columns; ++column){
+      // widths vary between half and one and a half of field_width
+      std::size_t width = field_width / 2 + random() % (field_width + 1);
+      for(std::size_t i = 0; i < width; ++i) content += static_cast<char>('a' + random() % 26);
+      content += column + 1 == columns ? '\n' : delimiter;
+    }
+  }
+  return content;
+}
+
+struct dataset {
+  std::size_t columns;
+  std::size_t field_width;
+  char delimiter;
+  std::string content;
+};
+
+// Delimiters are printed by name, so that results stay valid csv.
+const char* delimiter_name(char delimiter) {
+  switch(delimiter){
+    case ',': return "comma";
+    case ';': return "semicolon";
+    case '|': return "pipe";
+    case '\t': return "tab";
+    default: return "other";
+  }
+}
+
+template<typename Parse>
+void measure(const char* name, const dataset& data, Parse&& parse) {
+  std::size_t rows = 0;
+  std::size_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  parse(rows, checksum);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  double seconds = elapsed.count();
+  double megabytes = static_cast<double>(data.content.size()) / (1024 * 1024);
+  std::cout << name << ',' << data.columns << ',' << data.field_width << ',' << delimiter_name(data.delimiter) << ','
+            << data.content.size() << ',' << rows << ',' << seconds << ',' << megabytes / seconds << ','
+            << static_cast<double>(rows) / seconds << ',' << checksum << '\n';
+}
+
+template<typename Iterator>
+void count_rows(Iterator it, std::size_t& rows, std::size_t& checksum) {
+  for(auto& row : it){
+    ++rows;
+    checksum += row[0].size() + row[row.size() - 1].size();
+  }
+}
+
+template<std::size_t columns>
+void run(std::size_t field_width, char delimiter, std::size_t size) {
+  dataset data{columns, field_width, delimiter, generate(columns, field_width, delimiter, size)};
+  std::string_view buffer = data.content;
+
+  measure("buffer_unchecked", data, [&](std::size_t& rows, std::size_t& checksum){
+    count_rows(csv_iterator<columns, false>(buffer, delimiter), rows, checksum);
+  });
+  measure("buffer_checked", data, [&](std::size_t& rows, std::size_t& checksum){
+    count_rows(csv_iterator<columns, true>(buffer, delimiter), rows, checksum);
+  });
+  measure("buffer_dynamic_unchecked", data, [&](std::size_t& rows, std::size_t& checksum){
+    count_rows(csv_iterator<dynamic_width, false>(buffer, delimiter), rows, checksum);
+  });
+  measure("buffer_dynamic_checked", data, [&](std::size_t& rows, std::size_t& checksum){
+    count_rows(csv_iterator<dynamic_width, true>(buffer, delimiter), rows, checksum);
+  });
+  measure("buffer_first_column", data, [&](std::size_t& rows, std::size_t& checksum){
+    count_rows(csv_iterator<columns, false, csv::columns<0>>(buffer, delimiter), rows, checksum);
+  });
+  measure("buffer_quoted", data, [&](std::size_t& rows, std::size_t& checksum){
+    count_rows(csv_iterator<columns, false, rfc4180>(buffer, delimiter), rows, checksum);
+  });
+  measure("buffer_rewrite", data, [&](std::size_t& rows, std::size_t& checksum){
+    std::ostringstream output;
+    {
+      csv_writer<columns> writer(output, delimiter);
+      for(auto& row : csv_iterator<columns, false>(buffer, delimiter)){
+        writer.write(row);
+        ++rows;
+      }
+    }
+    checksum += static_cast<std::size_t>(output.tellp());
+  });
+  measure("istream_unchecked", data, [&](std::size_t& rows, std::size_t& checksum){
+    std::istringstream stream(data.content);
+    count_rows(csv_iterator<columns, false>(stream, delimiter), rows, checksum);
+  });
+  measure("istream_checked", data, [&](std::size_t& rows, std::size_t& checksum){
+    std::istringstream stream(data.content);
+    count_rows(csv_iterator<columns, true>(stream, delimiter), rows, checksum);
+  });
+  measure("block_reader_unchecked", data, [&](std::size_t& rows, std::size_t& checksum){
+    std::istringstream stream(data.content);
+    block_reader reader(stream);
+    count_rows(csv_iterator<columns, false>(reader, delimiter), rows, checksum);
+  });
+  measure("prefetch_reader_unchecked", data, [&](std::size_t& rows, std::size_t& checksum){
+    std::istringstream stream(data.content);
+    prefetch_reader reader(stream);
+    count_rows(csv_iterator<columns, false>(reader, delimiter), rows, checksum);
+  });
+}
+
+}
+
+// Usage: csv_parser_benchmarks [size in MiB per dataset, 32 by default]
+// Prints one csv line per measurement, starting with a header line.
+int main(int argc, char** argv) {
+  std::size_t size = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 32) * 1024 * 1024;
+
+  std::cout << "benchmark,columns,field_width,delimiter,bytes,rows,seconds,mb_per_s,rows_per_s,checksum\n";
+  run<1>(16, ',', size);
+  run<4>(8, ',', size);
+  run<4>(32, '|', size);
+  run<16>(4, ',', size);
+  run<16>(16, '\t', size);
+  run<64>(8, ';', size);
+}
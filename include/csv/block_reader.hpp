@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string_view>
+
+#include "csv.hpp"
+#include "details/line_buffer.hpp"
+
+namespace csv {
+
+// Reads a stream in large blocks into a reusable buffer and hands out whole lines from it, which makes
+// it suitable for streams that cannot be mapped, like pipes or standard input. Unlike the istream
+// constructor of csv_iterator, there is no per-line call into the stream and no per-line copy.
+// A line crossing block boundary is moved to the front of the buffer before the next block is read.
+// The buffer grows only if a single line does not fit into it.
+class block_reader : public line_reader {
+ public:
+  static constexpr ::std::size_t default_block_size = ::std::size_t(1) << 20;
+
+  explicit block_reader(::std::istream& stream, ::std::size_t block_size = default_block_size) :
+  stream_(&stream),
+  buffer_(block_size) {}
+
+  ::std::string_view next_lines() override {
+    // the last line of the stream may not be terminated with a newline
+    return buffer_.next_lines([this](char* data, ::std::size_t size) -> ::std::size_t {
+      if(eof_) return 0;
+      auto read = static_cast<::std::size_t>(stream_->rdbuf()->sgetn(data, static_cast<::std::streamsize>(size)));
+      if(read == 0) eof_ = true;
+      return read;
+    }, true);
+  }
+
+ private:
+  ::std::istream* stream_;
+  details::line_buffer buffer_;
+  bool eof_ = false;
+};
+
+}
@@ -30,10 +30,18 @@
 #include <istream>
 #include <string_view>
 #include <array>
-#include <vector>
 #include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "details/scanner.hpp"
 
 namespace csv {
 
@@ -41,32 +49,296 @@ struct csv_error : std::runtime_error{
   using std::runtime_error::runtime_error;
 };
 
+// Malformed content found in checked mode.
+enum class errc {
+  wrong_number_of_columns = 1,
+  unterminated_quoted_field,
+  unescaped_quote,
+  invalid_field
+};
+
+inline const ::std::error_category& error_category() noexcept {
+  struct category : ::std::error_category {
+    const char* name() const noexcept override { return "csv"; }
+
+    ::std::string message(int error) const override {
+      switch(static_cast<errc>(error)){
+        case errc::wrong_number_of_columns: return "csv file contains wrong number of rows.";
+        case errc::unterminated_quoted_field: return "csv file contains unterminated quoted field.";
+        case errc::unescaped_quote: return "csv file contains unescaped quote in quoted field.";
+        case errc::invalid_field: return "csv file contains field, that cannot be converted to the column type.";
+      }
+      return "unknown csv error.";
+    }
+  };
+  static const category instance;
+  return instance;
+}
+
+inline ::std::error_code make_error_code(errc error) noexcept {
+  return ::std::error_code(static_cast<int>(error), error_category());
+}
+
+}
+
+template<>
+struct std::is_error_code_enum<csv::errc> : ::std::true_type {};
+
+namespace csv {
+
+// Malformed line skipped in checked mode with skip_errors or report_errors option.
+struct parse_error {
+  ::std::error_code code;
+  // number of the line counting from 1, lines with quoted newlines are counted once
+  ::std::size_t line = 0;
+  // offset of the first byte of the line in the content
+  ::std::uint64_t offset = 0;
+};
+
+// Compact report of malformed lines skipped by csv_iterator.
+struct error_report {
+  ::std::size_t count = 0;
+  parse_error last;
+};
+
+using error_handler = ::std::function<void(const parse_error&)>;
+
+// Options of csv_iterator choosing what happens to malformed lines in checked mode. By default csv_error is thrown.
+// With skip_errors they are skipped, and counted along with the last of them in csv_iterator::errors().
+// report_errors does the same and additionally passes every one of them to the error_handler given to the constructor.
+struct skip_errors {};
+struct report_errors {};
+
+// Option of csv_iterator enabling RFC 4180 quoted fields, e.g. csv_iterator<3, false, rfc4180>.
+// Fields enclosed in double quotes may contain delimiters, newlines and quotes escaped as "".
+struct rfc4180 {};
+
+// Option of csv_iterator selecting columns (counting from 0), that are returned, e.g. csv_iterator<40, false, columns<3, 7>>
+// returns std::array with fields of the 4th and the 8th column. In unchecked mode the rest of the line after the last
+// selected column is skipped without looking for delimiters.
+template<std::size_t... indices>
+struct columns {};
+
+// Number of columns of csv_iterator, that is known only at runtime, e.g. csv_iterator<dynamic_width>.
+// It is taken from the first line, or from the constructor argument.
+inline constexpr ::std::size_t dynamic_width = 0;
+
+// Fields of a line parsed by csv_iterator<dynamic_width>. The fields are stored in the iterator, and the storage
+// is reused for the following lines, so the view is valid until the next increment.
+class row_view {
+ public:
+  using value_type = ::std::string_view;
+  using const_iterator = const ::std::string_view*;
+  using iterator = const_iterator;
+  using size_type = ::std::size_t;
+
+  row_view() noexcept = default;
+  row_view(const ::std::string_view* fields, ::std::size_t size) noexcept : fields_(fields), size_(size) {}
+
+  const ::std::string_view& operator[](::std::size_t column) const noexcept { return fields_[column]; }
+  const ::std::string_view* data() const noexcept { return fields_; }
+  ::std::size_t size() const noexcept { return size_; }
+  bool empty() const noexcept { return size_ == 0; }
+  const_iterator begin() const noexcept { return fields_; }
+  const_iterator end() const noexcept { return fields_ + size_; }
+
+ private:
+  const ::std::string_view* fields_ = nullptr;
+  ::std::size_t size_ = 0;
+};
+
+// Option of csv_iterator collecting parse_statistics, available through csv_iterator::statistics().
+// Without it nothing is counted or timed.
+struct collect_statistics {};
+
+struct parse_statistics {
+  // bytes of parsed lines, including newlines
+  ::std::size_t bytes = 0;
+  ::std::size_t rows = 0;
+  // delimiters located while splitting lines, in unchecked mode these following the last needed field are not counted
+  ::std::size_t delimiters = 0;
+  ::std::size_t longest_line = 0;
+  // lines rejected in checked mode
+  ::std::size_t check_failures = 0;
+  // time spent reading from the stream or line_reader, there is none for contiguous buffers
+  ::std::chrono::nanoseconds io_time{0};
+  // time spent splitting lines into fields
+  ::std::chrono::nanoseconds split_time{0};
+};
+
 namespace details {
 
-template<typename Iter, typename Predicate>
-auto find_all(Iter begin, const Iter end, Predicate pred) {
-  ::std::vector<typename ::std::iterator_traits<Iter>::pointer> elements;
-  auto& current = begin;
-  while (current != end) {
-    auto found_element = ::std::find_if(current, end, pred);
-    if (found_element != end) {
-      elements.push_back(std::addressof(*found_element));
-      ++found_element;
+struct no_statistics {};
+
+struct no_error_handler {};
+
+// Position of the next line and errors found so far, tracked unless errors are thrown.
+struct error_tracking {
+  ::std::size_t line = 1;
+  ::std::uint64_t offset = 0;
+  // offset of the last accepted line
+  ::std::uint64_t row_offset = 0;
+  // the last parsed line was skipped
+  bool rejected = false;
+  error_report report;
+};
+
+// Storage of fields of csv_iterator<dynamic_width>, the view covers the first width fields.
+struct dynamic_row {
+  dynamic_row() = default;
+
+  dynamic_row(const dynamic_row& rhs) : fields(rhs.fields), view(fields.data(), rhs.view.size()) {}
+
+  dynamic_row(dynamic_row&& rhs) noexcept = default;
+
+  dynamic_row& operator=(const dynamic_row& rhs) {
+    fields = rhs.fields;
+    view = row_view(fields.data(), rhs.view.size());
+    return *this;
+  }
+
+  dynamic_row& operator=(dynamic_row&& rhs) noexcept = default;
+
+  void set_width(::std::size_t width) {
+    fields.resize(width);
+    view = row_view(fields.data(), width);
+  }
+
+  ::std::string_view* begin() noexcept { return fields.data(); }
+  ::std::string_view* end() noexcept { return fields.data() + view.size(); }
+
+  ::std::vector<::std::string_view> fields;
+  row_view view;
+};
+
+template<typename Option, typename... Options>
+constexpr bool has_option = (::std::is_same_v<Option, Options> || ...);
+
+template<typename... Options>
+struct projection {
+  static constexpr bool enabled = false;
+  static constexpr std::size_t last_column = 0;
+};
+
+template<std::size_t... indices, typename... Options>
+struct projection<columns<indices...>, Options...> {
+  static constexpr bool enabled = true;
+  static constexpr std::size_t fields = sizeof...(indices);
+  static constexpr std::size_t last_column = ::std::max({indices...});
+  static constexpr ::std::array<std::size_t, sizeof...(indices)> selected{indices...};
+};
+
+template<typename Option, typename... Options>
+struct projection<Option, Options...> : projection<Options...> {};
+
+// Creates the selected fields of a line, out of positions of the first found_delimiters delimiters of the line.
+// Fields not terminated by any of the found delimiters end with the line.
+template<std::size_t N, std::size_t M>
+void create_projection(const char* begin, const char* end, const ::std::array<const char*, M>& comma_array,
+                       ::std::size_t found_delimiters, const ::std::array<std::size_t, N>& selected,
+                       ::std::array<::std::string_view, N>& result) {
+  for(std::size_t i = 0; i != N; ++i){
+    auto column = selected[i];
+    auto* field_begin = column == 0 ? begin : column <= found_delimiters ? comma_array[column - 1] + 1 : end;
+    auto* field_end = column < found_delimiters ? comma_array[column] : end;
+    result[i] = ::std::string_view(field_begin, field_end - field_begin);
+  }
+}
+
+// Removes enclosing quotes of quoted fields. Fields with escaped quotes are unescaped into scratch,
+// which is reserved up front to line_size, so that views created for previous fields stay valid.
+// In checked mode returns the error of malformed quoting, if any (errc{} otherwise).
+template<bool check_correctness, typename Fields>
+errc unquote_fields(Fields& fields, ::std::string& scratch, ::std::size_t line_size) {
+  scratch.clear();
+  for(auto& field : fields){
+    if(field.empty() || field.front() != quote) continue;
+
+    if(field.size() < 2 || field.back() != quote){
+      if constexpr (check_correctness) return errc::unterminated_quoted_field;
+      continue;
+    }
+
+    auto content = field.substr(1, field.size() - 2);
+    if(content.find(quote) == ::std::string_view::npos){
+      field = content;
+      continue;
+    }
+
+    if(scratch.empty()) scratch.reserve(line_size);
+    auto unescaped_begin = scratch.size();
+    for(::std::size_t i = 0; i < content.size(); ++i){
+      scratch.push_back(content[i]);
+      if(content[i] != quote) continue;
+      if constexpr (check_correctness) {
+        if(i + 1 == content.size() || content[i + 1] != quote) return errc::unescaped_quote;
+      }
+      ++i;
+    }
+    field = ::std::string_view(scratch.data() + unescaped_begin, scratch.size() - unescaped_begin);
+  }
+  return errc{};
+}
+
+// Collects positions of delimiters in the line the scanner is at into arr, and returns how many were found.
+// Scanning stops as soon as the array is full, so a line with too many delimiters is rejected early.
+// Otherwise line_end is set to the position of the newline ending the line, or to the end of the data.
+template<std::size_t N, typename Scanner>
+::std::size_t find_all(Scanner& scanner, const char*& line_end, ::std::array<const char*, N>& arr) {
+  ::std::size_t found_delimiters = 0;
+  for(auto* found = scanner.next(); found != scanner.end(); found = scanner.next()) {
+    if(*found == '\n') {
+      line_end = found;
+      return found_delimiters;
     }
-    current = found_element;
+    arr[found_delimiters++] = found;
+    if(found_delimiters == N) return found_delimiters;
   }
 
-  return elements;
+  line_end = scanner.end();
+  return found_delimiters;
 }
 
-template<std::size_t N, typename Iter, typename Predicate, typename Array = ::std::array<typename ::std::iterator_traits<Iter>::pointer, N>>
-Array find_n(Iter begin, Iter end, Predicate pred, Array&& arr = Array{}) {
-  if constexpr (N == 0) return arr;
-  else {
-    auto found_element = ::std::find_if(begin, end, pred);
-    arr[arr.size() - N] = std::addressof(*found_element);
-    return find_n<N-1>(++found_element, end, pred, arr);
+// Collects positions of first N delimiters in the line the scanner is at into arr and skips the rest of it.
+// Returns how many were found. line_end is set to the position of the newline ending the line, or to the end of the data.
+template<std::size_t N, typename Scanner>
+::std::size_t find_n(Scanner& scanner, const char*& line_end, ::std::array<const char*, N>& arr) {
+  for(::std::size_t found_delimiters = 0; found_delimiters != N; ++found_delimiters) {
+    auto* found = scanner.next();
+    if(found == scanner.end() || *found == '\n') {
+      line_end = found;
+      return found_delimiters;
+    }
+    arr[found_delimiters] = found;
   }
+
+  line_end = scanner.next_newline();
+  return N;
+}
+
+// Splits the line the scanner is at into fields, passing the column and the bounds of every field to store.
+// After limit delimiters the rest of the line belongs to the last field, and limit + 1 is returned, if the rest
+// contains a delimiter. Otherwise returns the number of found delimiters. line_end is set like in find_n.
+template<typename Scanner, typename Store>
+::std::size_t split_fields(Scanner& scanner, const char* line_begin, const char*& line_end, ::std::size_t limit, Store&& store) {
+  ::std::size_t found_delimiters = 0;
+  const char* field_begin = line_begin;
+  for(auto* found = scanner.next();; found = scanner.next()) {
+    if(found == scanner.end() || *found == '\n') {
+      line_end = found;
+      break;
+    }
+    if(found_delimiters == limit) {
+      line_end = scanner.next_newline();
+      store(found_delimiters, field_begin, line_end);
+      return limit + 1;
+    }
+    store(found_delimiters++, field_begin, found);
+    field_begin = found + 1;
+  }
+
+  store(found_delimiters, field_begin, line_end);
+  return found_delimiters;
 }
 
 template <typename T>
@@ -112,45 +384,139 @@ ArrResult create_result(Iter begin, Iter end, Array&& comma_array, ArrResult&& r
 
 }
 
-template<std::size_t rows_, bool check_correctness = false>
+// Source of csv content, that is not available in contiguous memory all at once.
+// next_lines returns the next portion of content, consisting of whole lines only. The returned memory
+// needs to stay valid until the following call. Empty result means, that there is no more content.
+class line_reader {
+ public:
+  virtual ~line_reader() = default;
+  virtual ::std::string_view next_lines() = 0;
+};
+
+template<std::size_t rows_, bool check_correctness = false, typename... options>
 class csv_iterator {
-  static_assert(rows_ >= 1, "csv_iterators needs to operate on stream, that has at least one column");
+  static constexpr bool dynamic = rows_ == dynamic_width;
+  static_assert(!dynamic || !details::projection<options...>::enabled, "columns cannot be selected with dynamic_width");
+  static_assert(dynamic || details::projection<options...>::last_column < rows_, "selected columns need to be less than the number of columns");
+  static constexpr bool quoting = details::has_option<rfc4180, options...>;
+  static constexpr bool collecting = details::has_option<collect_statistics, options...>;
+  static constexpr bool reporting = details::has_option<report_errors, options...>;
+  static constexpr bool throwing = !reporting && !details::has_option<skip_errors, options...>;
+  using projection = details::projection<options...>;
+  using scanner = details::structural_scanner<quoting>;
+  using statistics_type = ::std::conditional_t<collecting, parse_statistics, details::no_statistics>;
+  using error_tracking_type = ::std::conditional_t<throwing, details::no_statistics, details::error_tracking>;
  public:
+  using error_handler_type = ::std::conditional_t<reporting, error_handler, details::no_error_handler>;
   static constexpr std::size_t rows = rows_;
+  // number of returned fields, less than rows if only some columns are selected
+  static constexpr std::size_t fields = [] {
+    if constexpr (projection::enabled) return projection::fields;
+    else return rows;
+  }();
   using iterator_category = ::std::input_iterator_tag;
-  using value_type = ::std::array<::std::string_view, rows>;
-  using pointer = const ::std::array<::std::string_view, rows>*;
-  using reference = const ::std::array<::std::string_view, rows>&;
+  using value_type = ::std::conditional_t<dynamic, row_view, ::std::array<::std::string_view, fields>>;
+  using pointer = const value_type*;
+  using reference = const value_type&;
   using difference_type = std::ptrdiff_t;
 
-  csv_iterator() noexcept : stream_(nullptr) {}
+  csv_iterator() noexcept : stream_(nullptr), reader_(nullptr), position_(nullptr), end_(nullptr) {}
+
+  // columns is the number of columns of the content. Iterators with dynamic_width take it from the first line,
+  // when it is 0, others require it to be equal to rows. on_error receives malformed lines with report_errors option.
+  explicit csv_iterator(std::istream& stream, char delimiter = ',', std::size_t columns = rows_,
+                        error_handler_type on_error = {}) :
+      delimiter_(delimiter),
+      stream_(&stream),
+      reader_(nullptr),
+      position_(nullptr),
+      end_(nullptr) {
+    set_width(columns);
+    on_error_ = ::std::move(on_error);
+    operator++();
+  }
 
-  explicit csv_iterator(std::istream& stream, char delimiter = ',') :
+  // Iterates over csv content kept in contiguous memory (e.g. mapped_file).
+  // Returned string_views point directly into the buffer, so they stay valid
+  // for as long as the buffer lives, not only until the next increment.
+  explicit csv_iterator(std::string_view buffer, char delimiter = ',', std::size_t columns = rows_,
+                        error_handler_type on_error = {}) :
       delimiter_(delimiter),
-      stream_(&stream) {
+      stream_(nullptr),
+      reader_(nullptr),
+      position_(buffer.data()),
+      end_(buffer.data() + buffer.size()),
+      scanner_(position_, end_, delimiter) {
+    set_width(columns);
+    on_error_ = ::std::move(on_error);
     operator++();
   }
 
+  // Iterates over content provided by the reader (e.g. block_reader) portion by portion.
+  // Returned string_views point into the memory of the reader, and are valid until the next increment.
+  explicit csv_iterator(line_reader& reader, char delimiter = ',', std::size_t columns = rows_,
+                        error_handler_type on_error = {}) :
+      delimiter_(delimiter),
+      stream_(nullptr),
+      reader_(&reader),
+      position_(nullptr),
+      end_(nullptr) {
+    set_width(columns);
+    on_error_ = ::std::move(on_error);
+    operator++();
+  }
+
+  // With report_errors option, the number of columns can be left out, when passing on_error.
+  template<bool enabled = reporting, typename = ::std::enable_if_t<enabled>>
+  csv_iterator(std::istream& stream, char delimiter, error_handler_type on_error) :
+  csv_iterator(stream, delimiter, rows_, ::std::move(on_error)) {}
+
+  template<bool enabled = reporting, typename = ::std::enable_if_t<enabled>>
+  csv_iterator(std::string_view buffer, char delimiter, error_handler_type on_error) :
+  csv_iterator(buffer, delimiter, rows_, ::std::move(on_error)) {}
+
+  template<bool enabled = reporting, typename = ::std::enable_if_t<enabled>>
+  csv_iterator(line_reader& reader, char delimiter, error_handler_type on_error) :
+  csv_iterator(reader, delimiter, rows_, ::std::move(on_error)) {}
+
   csv_iterator(const csv_iterator& rhs) :
   delimiter_(rhs.delimiter_),
   stream_(rhs.stream_),
-  result_(rhs.result_){
-    parse_line(); // todo optimize
+  reader_(rhs.reader_),
+  position_(rhs.position_),
+  end_(rhs.end_),
+  scanner_(rhs.scanner_),
+  result_(rhs.result_),
+  statistics_(rhs.statistics_),
+  errors_(rhs.errors_),
+  on_error_(rhs.on_error_){
   }
 
   csv_iterator(csv_iterator&& rhs) noexcept :
   delimiter_(rhs.delimiter_),
   stream_(rhs.stream_),
-  result_(std::move(rhs.result_))
+  reader_(rhs.reader_),
+  position_(rhs.position_),
+  end_(rhs.end_),
+  scanner_(rhs.scanner_),
+  result_(std::move(rhs.result_)),
+  statistics_(rhs.statistics_),
+  errors_(rhs.errors_),
+  on_error_(std::move(rhs.on_error_))
   {
-    parse_line(); // todo optimize
   }
 
   csv_iterator& operator=(const csv_iterator& rhs){
     delimiter_ = rhs.delimiter_;
     stream_ = rhs.stream_;
+    reader_ = rhs.reader_;
+    position_ = rhs.position_;
+    end_ = rhs.end_;
+    scanner_ = rhs.scanner_;
     result_ = rhs.result_;
-    parse_line(); // update string_views in cached result
+    statistics_ = rhs.statistics_;
+    errors_ = rhs.errors_;
+    on_error_ = rhs.on_error_;
 
     return *this;
   }
@@ -158,8 +524,14 @@ class csv_iterator {
   csv_iterator& operator=(csv_iterator&& rhs){
     delimiter_ = rhs.delimiter_;
     stream_ = rhs.stream_;
+    reader_ = rhs.reader_;
+    position_ = rhs.position_;
+    end_ = rhs.end_;
+    scanner_ = rhs.scanner_;
     result_ = std::move(rhs.result_);
-    parse_line(); // update string_views in cached result
+    statistics_ = rhs.statistics_;
+    errors_ = rhs.errors_;
+    on_error_ = std::move(rhs.on_error_);
 
     return *this;
   }
@@ -167,21 +539,46 @@ class csv_iterator {
   ~csv_iterator() = default;
 
   reference operator*() const {
-    return result_.result;
+    if constexpr (dynamic) return result_.result.view;
+    else return result_.result;
   }
 
   pointer operator->() const {
-    return &result_.result;
+    return &operator*();
   }
 
-  csv_iterator& operator++() {
-    if(!::std::getline(*stream_, result_.line_)){
-      std::cerr << std::boolalpha << stream_->bad() << stream_->eof() << stream_->fail();
-      stream_ = nullptr;
-      return *this;
+  // Number of columns, for iterators with dynamic_width 0 until the first line is parsed, unless it was given.
+  std::size_t width() const noexcept {
+    if constexpr (dynamic) return result_.result.view.size();
+    else return rows;
+  }
+
+  // Statistics of the lines parsed by this iterator, available with collect_statistics option.
+  const parse_statistics& statistics() const noexcept {
+    static_assert(collecting, "statistics are collected only with collect_statistics option");
+    return statistics_;
+  }
+
+  // Malformed lines skipped so far, available with skip_errors or report_errors option.
+  const error_report& errors() const noexcept {
+    static_assert(!throwing, "errors are skipped only with skip_errors or report_errors option");
+    return errors_.report;
+  }
+
+  // Rejects the current row, that was found malformed by the caller (e.g. csv_typed_iterator), according to
+  // the error policy. Without skip_errors or report_errors throws csv_error, otherwise moves to the next row.
+  csv_iterator& reject(errc error) {
+    if constexpr (throwing) {
+      report(error, 0, 0);
+    } else {
+      report(error, errors_.line - 1, errors_.row_offset);
     }
+    return operator++();
+  }
 
-    parse_line();
+  csv_iterator& operator++() {
+    // skipped lines are followed by the next one
+    while(!advance()) {}
     return *this;
   }
 
@@ -193,31 +590,308 @@ class csv_iterator {
 
  private:
 
-  void parse_line(){
-    auto predicate = [this](char letter){return letter == delimiter_;};
-    if constexpr (check_correctness) {
-      auto comma_positions = details::find_all(result_.line_.begin(), result_.line_.end(), predicate);
-      if(comma_positions.size() != rows - 1){
-        throw csv_error("csv file contains wrong number of rows.");
+  // Parses the next line, returns false if it was malformed and skipped.
+  bool advance() {
+    if(stream_) {
+      bool read = timed(&parse_statistics::io_time, [this]{
+        if(!::std::getline(*stream_, result_.line_)) return false;
+        if constexpr (quoting) read_quoted_newlines();
+        return true;
+      });
+      if(!read){
+        stream_ = nullptr;
+        return true;
+      }
+
+      parse_line(result_.line_);
+      consumed(!stream_->eof()); // newline is not a part of the line
+      return accepted();
+    }
+
+    if(position_ == end_ && !next_lines()){
+      reader_ = nullptr;
+      position_ = end_ = nullptr;
+      return true;
+    }
+
+    auto* line_end = parse_line(scanner_, position_, reader_ != nullptr);
+    if(!line_end) {
+      parse_carried_over_line();
+      return accepted();
+    }
+    position_ = (line_end == end_) ? end_ : line_end + 1;
+    return accepted();
+  }
+
+  bool accepted() noexcept {
+    if constexpr (throwing) return true;
+    else return !errors_.rejected;
+  }
+
+  // Accounts bytes of the content passed by the iterator.
+  void consumed(::std::size_t bytes) noexcept {
+    if constexpr (collecting) statistics_.bytes += bytes;
+    if constexpr (!throwing) errors_.offset += bytes;
+  }
+
+  void set_width(std::size_t columns) {
+    if constexpr (dynamic) {
+      result_.result.set_width(columns);
+    } else if(columns != rows) {
+      throw ::std::invalid_argument("number of columns differs from the rows of the iterator");
+    }
+  }
+
+  bool next_lines(bool in_quotes = false) {
+    if(!reader_) return false;
+
+    auto lines = timed(&parse_statistics::io_time, [this]{ return reader_->next_lines(); });
+    if(lines.empty()) return false;
+
+    position_ = lines.data();
+    end_ = lines.data() + lines.size();
+    scanner_ = scanner(position_, end_, delimiter_, in_quotes);
+    return true;
+  }
+
+  // getline stops at newlines inside of quoted fields, append following lines until the quote is closed
+  void read_quoted_newlines(){
+    bool in_quotes = ::std::count(result_.line_.begin(), result_.line_.end(), details::quote) % 2;
+    ::std::string continuation;
+    while(in_quotes && ::std::getline(*stream_, continuation)){
+      in_quotes ^= ::std::count(continuation.begin(), continuation.end(), details::quote) % 2;
+      result_.line_ += '\n';
+      result_.line_ += continuation;
+    }
+  }
+
+  // The reader split a quoted field spanning multiple lines. Gather the rest of the line
+  // from the following portions of the reader into the cached line and parse it from there.
+  void parse_carried_over_line(){
+    result_.line_.assign(position_, end_);
+    position_ = end_;
+    bool newline = false;
+    while(next_lines(true)){
+      const char* found = scanner_.next();
+      while(found != end_ && *found != '\n') found = scanner_.next();
+
+      result_.line_.append(position_, found);
+      position_ = (found == end_) ? end_ : found + 1;
+      newline = found != end_;
+      if(newline || !scanner_.in_quotes()) break;
+    }
+    parse_line(result_.line_);
+    consumed(newline);
+  }
+
+  void parse_line(::std::string_view line){
+    scanner line_scanner(line.data(), line.data() + line.size(), delimiter_);
+    parse_line(line_scanner, line.data());
+  }
+
+  // Splits the line starting at line_begin, returns position of the newline ending it or the end of data.
+  // With may_continue, nullptr is returned instead, when the data ends inside of a quoted field.
+  const char* parse_line(scanner& line_scanner, const char* line_begin, bool may_continue = false){
+    return timed(&parse_statistics::split_time, [&]{ return split_line(line_scanner, line_begin, may_continue); });
+  }
+
+  const char* split_line(scanner& line_scanner, const char* line_begin, bool may_continue){
+    const char* line_end = nullptr;
+    ::std::size_t found_delimiters;
+    if constexpr (dynamic) {
+      found_delimiters = split_dynamic(line_scanner, line_begin, line_end);
+      if(line_continues(line_scanner, line_end, may_continue)) return nullptr;
+      if(!check_width(found_delimiters)) return reject(errc::wrong_number_of_columns, line_scanner, line_begin, line_end);
+    } else if constexpr (check_correctness) {
+      // one slot more than needed, so that a line with too many delimiters can be detected
+      ::std::array<const char*, rows> comma_positions;
+      found_delimiters = details::find_all(line_scanner, line_end, comma_positions);
+      if(found_delimiters == rows) line_end = line_scanner.next_newline();
+      if(line_continues(line_scanner, line_end, may_continue)) return nullptr;
+      if(found_delimiters != rows - 1){
+        return reject(errc::wrong_number_of_columns, line_scanner, line_begin, line_end);
       }
 
-      auto* comma_positions_array = comma_positions.data();
-      result_.result = details::create_result<rows>(result_.line_.begin(), result_.line_.end(), comma_positions_array);
+      if constexpr (projection::enabled) {
+        details::create_projection(line_begin, line_end, comma_positions, rows - 1, projection::selected, result_.result);
+      } else {
+        result_.result = details::create_result<rows>(line_begin, line_end, comma_positions);
+      }
+    } else if constexpr (projection::enabled) {
+      // delimiters following the last selected column are not needed
+      constexpr std::size_t needed_delimiters = ::std::min(projection::last_column + 1, rows - 1);
+      ::std::array<const char*, needed_delimiters> comma_positions;
+      found_delimiters = details::find_n(line_scanner, line_end, comma_positions);
+      if(line_continues(line_scanner, line_end, may_continue)) return nullptr;
+      details::create_projection(line_begin, line_end, comma_positions, found_delimiters, projection::selected, result_.result);
     } else {
-      auto comma_positions = details::find_n<rows-1>(result_.line_.begin(),
-                                                     result_.line_.end(),
-                                                     predicate);
-      result_.result = details::create_result<rows>(result_.line_.begin(), result_.line_.end(), comma_positions);
+      ::std::array<const char*, rows-1> comma_positions;
+      found_delimiters = details::find_n(line_scanner, line_end, comma_positions);
+      if(line_continues(line_scanner, line_end, may_continue)) return nullptr;
+      result_.result = details::create_result<rows>(line_begin, line_end, comma_positions);
     }
+
+    if constexpr (quoting) {
+      if constexpr (check_correctness) {
+        if(line_end == line_scanner.end() && line_scanner.in_quotes()) {
+          return reject(errc::unterminated_quoted_field, line_scanner, line_begin, line_end);
+        }
+      }
+      auto error = details::unquote_fields<check_correctness>(result_.result, result_.scratch_, line_end - line_begin);
+      if(error != errc{}) return reject(error, line_scanner, line_begin, line_end);
+    }
+
+    ::std::size_t line_size = static_cast<::std::size_t>(line_end - line_begin);
+    if constexpr (collecting) {
+      ++statistics_.rows;
+      statistics_.delimiters += found_delimiters;
+      statistics_.longest_line = ::std::max(statistics_.longest_line, line_size);
+    }
+    if constexpr (!throwing) {
+      errors_.rejected = false;
+      errors_.row_offset = errors_.offset;
+      ++errors_.line;
+    }
+    consumed(line_size + (line_end != line_scanner.end()));
+    return line_end;
+  }
+
+  // Throws csv_error for the malformed line, or skips it and reports the error, depending on the options.
+  const char* reject(errc error, const scanner& line_scanner, const char* line_begin, const char* line_end){
+    if constexpr (throwing) {
+      report(error, 0, 0);
+    } else {
+      report(error, errors_.line, errors_.offset);
+      ++errors_.line;
+      errors_.rejected = true;
+      consumed(static_cast<::std::size_t>(line_end - line_begin) + (line_end != line_scanner.end()));
+    }
+    return line_end;
+  }
+
+  // Throws csv_error, or counts and reports the error of the line, depending on the options.
+  void report(errc error, [[maybe_unused]] ::std::size_t line, [[maybe_unused]] ::std::uint64_t offset){
+    if constexpr (collecting) ++statistics_.check_failures;
+    if constexpr (throwing) {
+      throw csv_error(make_error_code(error).message());
+    } else {
+      parse_error found{make_error_code(error), line, offset};
+      ++errors_.report.count;
+      errors_.report.last = found;
+      if constexpr (reporting) {
+        if(on_error_) on_error_(found);
+      }
+    }
+  }
+
+  ::std::size_t split_dynamic(scanner& line_scanner, const char* line_begin, const char*& line_end){
+    auto& stored = result_.result.fields;
+    auto width = result_.result.view.size();
+    if(width == 0) {
+      // the first line grows the storage, following ones reuse it
+      stored.clear();
+      return details::split_fields(line_scanner, line_begin, line_end, ::std::string_view::npos,
+                                   [&stored](::std::size_t, const char* begin, const char* end){ stored.emplace_back(begin, end - begin); });
+    }
+    // in checked mode, more delimiters than needed are found only in lines, that are rejected
+    return details::split_fields(line_scanner, line_begin, line_end, width - 1,
+                                 [stored = stored.data()](::std::size_t column, const char* begin, const char* end){
+                                   stored[column] = ::std::string_view(begin, end - begin);
+                                 });
+  }
+
+  // Settles the width on the first line, returns false if a line of a different width is rejected.
+  // In unchecked mode fields missing in short lines are empty.
+  bool check_width(::std::size_t found_delimiters){
+    auto& row = result_.result;
+    if(row.view.size() == 0) {
+      row.set_width(found_delimiters + 1);
+      return true;
+    }
+    if constexpr (check_correctness) {
+      return found_delimiters + 1 == row.view.size();
+    } else {
+      ::std::fill(row.fields.begin() + ::std::min(found_delimiters + 1, row.fields.size()), row.fields.end(), ::std::string_view{});
+      return true;
+    }
+  }
+
+  // Calls function, measuring its duration into the counter if statistics are collected.
+  template<typename Function>
+  auto timed(::std::chrono::nanoseconds parse_statistics::* counter, Function&& function) {
+    if constexpr (collecting) {
+      auto start = ::std::chrono::steady_clock::now();
+      auto result = function();
+      statistics_.*counter += ::std::chrono::steady_clock::now() - start;
+      return result;
+    } else {
+      (void)counter;
+      return function();
+    }
+  }
+
+  static bool line_continues(const scanner& line_scanner, const char* line_end, bool may_continue) noexcept {
+    if constexpr (quoting) return may_continue && line_end == line_scanner.end() && line_scanner.in_quotes();
+    else return false;
   }
 
   struct cached_result {
+    cached_result() = default;
+
+    cached_result(const cached_result& rhs) :
+    line_(rhs.line_),
+    scratch_(rhs.scratch_),
+    result(rhs.result) {
+      rebase(rhs.line_, rhs.scratch_);
+    }
+
+    cached_result(cached_result&& rhs) noexcept {
+      *this = ::std::move(rhs);
+    }
+
+    cached_result& operator=(const cached_result& rhs) {
+      line_ = rhs.line_;
+      scratch_ = rhs.scratch_;
+      result = rhs.result;
+      rebase(rhs.line_, rhs.scratch_);
+      return *this;
+    }
+
+    cached_result& operator=(cached_result&& rhs) noexcept {
+      ::std::string_view previous_line = rhs.line_;
+      ::std::string_view previous_scratch = rhs.scratch_;
+      line_ = ::std::move(rhs.line_);
+      scratch_ = ::std::move(rhs.scratch_);
+      result = ::std::move(rhs.result);
+      rebase(previous_line, previous_scratch);
+      return *this;
+    }
+
+    // points fields referring to the line or the scratch of another result into the own ones, instead of parsing the line again
+    void rebase(::std::string_view previous_line, ::std::string_view previous_scratch) noexcept {
+      for(auto& field : result){
+        if(!rebase(field, previous_line, line_)) rebase(field, previous_scratch, scratch_);
+      }
+    }
+
+    static bool rebase(::std::string_view& field, ::std::string_view previous, const ::std::string& current) noexcept {
+      ::std::less_equal<const char*> less_equal;
+      if(!less_equal(previous.data(), field.data()) || !less_equal(field.data() + field.size(), previous.data() + previous.size())){
+        return false;
+      }
+      field = ::std::string_view(current.data() + (field.data() - previous.data()), field.size());
+      return true;
+    }
+
     ::std::string line_;
-    ::std::array<::std::string_view, rows> result;
+    ::std::string scratch_;
+    ::std::conditional_t<dynamic, details::dynamic_row, ::std::array<::std::string_view, fields>> result;
   };
 
   friend bool operator==(const csv_iterator& lhs, const csv_iterator& rhs) {
-    return lhs.stream_ == rhs.stream_;
+    // all iterators over the same stream or reader are equal, until they reach the end
+    if(lhs.stream_ != rhs.stream_ || lhs.reader_ != rhs.reader_) return false;
+    return lhs.stream_ || lhs.reader_ || lhs.position_ == rhs.position_;
   }
 
   friend bool operator!=(const csv_iterator& lhs, const csv_iterator& rhs) {
@@ -238,7 +912,14 @@ class csv_iterator {
 
   char delimiter_;
   ::std::istream *stream_;
+  line_reader* reader_;
+  const char* position_;
+  const char* end_;
+  scanner scanner_;
   cached_result result_;
+  statistics_type statistics_;
+  error_tracking_type errors_;
+  error_handler_type on_error_;
 };
 
 }
\ No newline at end of file
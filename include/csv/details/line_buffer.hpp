@@ -0,0 +1,101 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string_view>
+
+namespace csv {
+namespace details {
+
+// Reusable buffer of line_readers handing out whole lines of content read into it. A line crossing the end
+// of the read content is moved to the front of the buffer before more is read. The buffer grows only if
+// a single line does not fit into it.
+class line_buffer {
+ public:
+  explicit line_buffer(::std::size_t capacity) :
+  capacity_(::std::max<::std::size_t>(capacity, 1)),
+  buffer_(new char[capacity_]) {}
+
+  // fill(data, size) reads at most size bytes into data and returns how many it read, 0 when no more content
+  // is available. Then the trailing line without a newline is handed out too with hand_out_partial, otherwise
+  // it is kept for the next call and no content is returned.
+  template<typename Fill>
+  ::std::string_view next_lines(Fill&& fill, bool hand_out_partial) {
+    // whatever was handed out before is no longer needed, keep only the incomplete line
+    ::std::size_t pending = filled_ - consumed_;
+    ::std::memmove(buffer_.get(), buffer_.get() + consumed_, pending);
+    filled_ = pending;
+    consumed_ = 0;
+
+    ::std::size_t searched = filled_; // bytes before this offset are known not to contain a newline
+    for(;;) {
+      if(filled_ == capacity_) grow();
+      ::std::size_t read = fill(buffer_.get() + filled_, capacity_ - filled_);
+      filled_ += read;
+
+      auto search_begin = ::std::make_reverse_iterator(buffer_.get() + filled_);
+      auto search_end = ::std::make_reverse_iterator(buffer_.get() + searched);
+      auto last_newline = ::std::find(search_begin, search_end, '\n');
+      if(last_newline != search_end) {
+        consumed_ = static_cast<::std::size_t>(last_newline.base() - buffer_.get());
+        return ::std::string_view(buffer_.get(), consumed_);
+      }
+
+      if(read == 0) {
+        if(hand_out_partial) consumed_ = filled_;
+        return ::std::string_view(buffer_.get(), consumed_);
+      }
+      searched = filled_;
+    }
+  }
+
+  // Number of bytes read, but not handed out yet.
+  ::std::size_t pending() const noexcept {
+    return filled_ - consumed_;
+  }
+
+ private:
+  void grow() {
+    ::std::unique_ptr<char[]> bigger(new char[capacity_ * 2]);
+    ::std::memcpy(bigger.get(), buffer_.get(), filled_);
+    buffer_ = ::std::move(bigger);
+    capacity_ *= 2;
+  }
+
+  ::std::size_t capacity_;
+  ::std::unique_ptr<char[]> buffer_;
+  ::std::size_t filled_ = 0;
+  ::std::size_t consumed_ = 0;
+};
+
+}
+}
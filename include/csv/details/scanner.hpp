@@ -0,0 +1,281 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CSV_ITERATOR_HAS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CSV_ITERATOR_HAS_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define CSV_ITERATOR_HAS_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace csv {
+namespace details {
+
+constexpr ::std::size_t block_size = 64;
+constexpr char quote = '"';
+
+// Bit i of every mask is set, when i-th byte of the 64 byte block matches.
+// Quotes are matched only by kernels instantiated for quoted content.
+struct block_masks {
+  ::std::uint64_t delimiters;
+  ::std::uint64_t newlines;
+  ::std::uint64_t quotes;
+};
+
+using match_kernel = block_masks (*)(const char* block, char delimiter) noexcept;
+
+inline unsigned trailing_zeros(::std::uint64_t value) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+// Bit i of the result is xor of bits 0..i of the value. Applied to positions of quotes
+// it marks every byte from an opening quote up to (excluding) the closing one.
+inline ::std::uint64_t prefix_xor(::std::uint64_t value) noexcept {
+  value ^= value << 1;
+  value ^= value << 2;
+  value ^= value << 4;
+  value ^= value << 8;
+  value ^= value << 16;
+  value ^= value << 32;
+  return value;
+}
+
+template<bool quoting>
+block_masks match_scalar(const char* block, char delimiter) noexcept {
+  block_masks masks{0, 0, 0};
+  for(::std::size_t i = 0; i < block_size; ++i){
+    masks.delimiters |= ::std::uint64_t(block[i] == delimiter) << i;
+    masks.newlines |= ::std::uint64_t(block[i] == '\n') << i;
+    if constexpr (quoting) masks.quotes |= ::std::uint64_t(block[i] == quote) << i;
+  }
+  return masks;
+}
+
+#ifdef CSV_ITERATOR_HAS_SSE2
+inline ::std::uint64_t sse2_match(__m128i chunk, __m128i pattern, ::std::size_t shift) noexcept {
+  return ::std::uint64_t(static_cast<::std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, pattern)))) << shift;
+}
+
+template<bool quoting>
+block_masks match_sse2(const char* block, char delimiter) noexcept {
+  const __m128i delimiters = _mm_set1_epi8(delimiter);
+  const __m128i newlines = _mm_set1_epi8('\n');
+  const __m128i quotes = _mm_set1_epi8(quote);
+  block_masks masks{0, 0, 0};
+  for(::std::size_t i = 0; i < block_size; i += 16){
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+    masks.delimiters |= sse2_match(chunk, delimiters, i);
+    masks.newlines |= sse2_match(chunk, newlines, i);
+    if constexpr (quoting) masks.quotes |= sse2_match(chunk, quotes, i);
+  }
+  return masks;
+}
+#endif
+
+#ifdef CSV_ITERATOR_HAS_AVX2
+__attribute__((target("avx2")))
+inline ::std::uint64_t avx2_match(__m256i low, __m256i high, __m256i pattern) noexcept {
+  auto low_mask = static_cast<::std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, pattern)));
+  auto high_mask = static_cast<::std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, pattern)));
+  return ::std::uint64_t(low_mask) | (::std::uint64_t(high_mask) << 32);
+}
+
+template<bool quoting>
+__attribute__((target("avx2")))
+block_masks match_avx2(const char* block, char delimiter) noexcept {
+  __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+  block_masks masks{avx2_match(low, high, _mm256_set1_epi8(delimiter)),
+                    avx2_match(low, high, _mm256_set1_epi8('\n')),
+                    0};
+  if constexpr (quoting) masks.quotes = avx2_match(low, high, _mm256_set1_epi8(quote));
+  return masks;
+}
+#endif
+
+#ifdef CSV_ITERATOR_HAS_NEON
+inline ::std::uint64_t neon_match(const uint8x16_t (&chunks)[4], uint8x16_t pattern) noexcept {
+  const uint8x16_t bits = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                           0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+  uint8x16_t sum0 = vpaddq_u8(vandq_u8(vceqq_u8(chunks[0], pattern), bits), vandq_u8(vceqq_u8(chunks[1], pattern), bits));
+  uint8x16_t sum1 = vpaddq_u8(vandq_u8(vceqq_u8(chunks[2], pattern), bits), vandq_u8(vceqq_u8(chunks[3], pattern), bits));
+  sum0 = vpaddq_u8(sum0, sum1);
+  sum0 = vpaddq_u8(sum0, sum0);
+  return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+}
+
+template<bool quoting>
+block_masks match_neon(const char* block, char delimiter) noexcept {
+  auto* bytes = reinterpret_cast<const ::std::uint8_t*>(block);
+  const uint8x16_t chunks[4] = {vld1q_u8(bytes), vld1q_u8(bytes + 16), vld1q_u8(bytes + 32), vld1q_u8(bytes + 48)};
+  block_masks masks{neon_match(chunks, vdupq_n_u8(static_cast<::std::uint8_t>(delimiter))),
+                    neon_match(chunks, vdupq_n_u8('\n')),
+                    0};
+  if constexpr (quoting) masks.quotes = neon_match(chunks, vdupq_n_u8(static_cast<::std::uint8_t>(quote)));
+  return masks;
+}
+#endif
+
+template<bool quoting>
+match_kernel select_kernel() noexcept {
+#ifdef CSV_ITERATOR_HAS_AVX2
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return match_avx2<quoting>;
+#endif
+#if defined(CSV_ITERATOR_HAS_SSE2)
+  return match_sse2<quoting>;
+#elif defined(CSV_ITERATOR_HAS_NEON)
+  return match_neon<quoting>;
+#else
+  return match_scalar<quoting>;
+#endif
+}
+
+// chosen once per program, depending on the capabilities of the cpu it runs on. A function local static
+// is initialized on first use, so scanning works also from initializers of other static variables.
+template<bool quoting>
+inline match_kernel active_kernel() noexcept {
+  static const match_kernel kernel = select_kernel<quoting>();
+  return kernel;
+}
+
+// Finds delimiters and newlines in [begin, end) in a single pass, 64 bytes at a time.
+// Matches of each block are kept as a bitmask and handed out one by one.
+// With quoting, delimiters and newlines placed between quotes are not reported.
+template<bool quoting = false>
+class structural_scanner {
+ public:
+  structural_scanner() noexcept = default;
+
+  // in_quotes tells whether data starts inside of a quoted field
+  structural_scanner(const char* begin, const char* end, char delimiter, bool in_quotes = false) noexcept :
+  data_(begin),
+  size_(static_cast<::std::size_t>(end - begin)),
+  quote_carry_(in_quotes ? ~::std::uint64_t(0) : 0),
+  delimiter_(delimiter) {
+    load(0);
+  }
+
+  // Returns position of the next delimiter or newline, or the end of scanned data if there is none.
+  const char* next() noexcept {
+    while(structurals_ == 0){
+      if(size_ - offset_ <= block_size) return data_ + size_;
+      load(offset_ + block_size);
+    }
+
+    auto* found = data_ + offset_ + trailing_zeros(structurals_);
+    structurals_ &= structurals_ - 1;
+    return found;
+  }
+
+  // Skips delimiters up to the next newline and returns its position, or the end of scanned data if there is none.
+  const char* next_newline() noexcept {
+    while((structurals_ & newlines_) == 0){
+      if(size_ - offset_ <= block_size) {
+        structurals_ = 0;
+        return data_ + size_;
+      }
+      load(offset_ + block_size);
+    }
+
+    auto index = trailing_zeros(structurals_ & newlines_);
+    structurals_ &= ~((::std::uint64_t(2) << index) - 1);
+    return data_ + offset_ + index;
+  }
+
+  const char* end() const noexcept {
+    return data_ + size_;
+  }
+
+  // Whether the end of the loaded data is inside of a quoted field. Once next() returned end(),
+  // it tells whether the scanned data ends with an unterminated quoted field.
+  bool in_quotes() const noexcept {
+    return quote_carry_ != 0;
+  }
+
+ private:
+  void load(::std::size_t offset) noexcept {
+    offset_ = offset;
+    ::std::size_t remaining = size_ - offset;
+    block_masks masks;
+    if(remaining >= block_size){
+      masks = active_kernel<quoting>()(data_ + offset, delimiter_);
+    } else {
+      // never read past the end of the data, the tail is matched from a zero padded copy
+      char padded[block_size] = {};
+      if(remaining != 0) ::std::memcpy(padded, data_ + offset, remaining);
+      masks = active_kernel<quoting>()(padded, delimiter_);
+      ::std::uint64_t valid = remaining == 0 ? 0 : (~::std::uint64_t(0) >> (block_size - remaining));
+      masks.delimiters &= valid;
+      masks.newlines &= valid;
+      masks.quotes &= valid;
+    }
+
+    structurals_ = masks.delimiters | masks.newlines;
+    newlines_ = masks.newlines;
+    if constexpr (quoting) {
+      ::std::uint64_t quoted = prefix_xor(masks.quotes) ^ quote_carry_;
+      quote_carry_ = ::std::uint64_t(::std::int64_t(quoted) >> 63);
+      structurals_ &= ~quoted;
+      newlines_ &= ~quoted;
+    }
+  }
+
+  const char* data_ = nullptr;
+  ::std::size_t size_ = 0;
+  ::std::size_t offset_ = 0;
+  ::std::uint64_t structurals_ = 0;
+  ::std::uint64_t newlines_ = 0;
+  ::std::uint64_t quote_carry_ = 0;
+  char delimiter_ = ',';
+};
+
+}
+}
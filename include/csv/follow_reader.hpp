@@ -0,0 +1,98 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "csv.hpp"
+#include "details/line_buffer.hpp"
+
+namespace csv {
+
+// Reads a file, that is being appended to (e.g. a log), starting at the given byte offset. Only whole lines are
+// handed out, a trailing line without a newline is held back until it is completed. When no complete line
+// was appended, next_lines returns no content, so csv_iterator over the reader ends. A new iterator created
+// over the same reader later continues with the lines appended in the meantime.
+// checkpoint() is the offset of the first line not handed out yet. Once an iterator reaches its end, all lines
+// before it were processed, so it can be persisted and passed to the constructor to resume after a restart.
+// Line ends are found without regard to quoting, so a quoted field spanning lines may be split, if its line is
+// appended only partially at the time of polling.
+class follow_reader : public line_reader {
+ public:
+  static constexpr ::std::size_t default_block_size = ::std::size_t(1) << 20;
+
+  explicit follow_reader(const ::std::string& path, ::std::uint64_t offset = 0, ::std::size_t block_size = default_block_size) :
+  path_(path),
+  file_(path, ::std::ios::binary),
+  read_offset_(offset),
+  buffer_(block_size) {
+    if(!file_) throw csv_error("cannot open csv file " + path + ".");
+    seek();
+  }
+
+  ::std::string_view next_lines() override {
+    bool at_end = false;
+    return buffer_.next_lines([this, &at_end](char* data, ::std::size_t size) -> ::std::size_t {
+      if(at_end) return 0;
+      // reaching the end of the file leaves the stream failed, seeking again lets it see newly appended content
+      if(!file_) seek();
+
+      file_.read(data, static_cast<::std::streamsize>(size));
+      auto read = static_cast<::std::size_t>(file_.gcount());
+      read_offset_ += read;
+      at_end = read < size;
+      return read;
+    }, false);
+  }
+
+  // Offset of the first byte of the file, that was not handed out yet.
+  ::std::uint64_t checkpoint() const noexcept {
+    return read_offset_ - buffer_.pending();
+  }
+
+ private:
+  void seek() {
+    file_.clear();
+    file_.seekg(0, ::std::ios::end);
+    auto size = file_.tellg();
+    if(size < 0 || static_cast<::std::uint64_t>(size) < read_offset_) {
+      throw csv_error("csv file " + path_ + " is shorter than the followed offset.");
+    }
+    file_.seekg(static_cast<::std::streamoff>(read_offset_));
+  }
+
+  ::std::string path_;
+  ::std::ifstream file_;
+  ::std::uint64_t read_offset_;
+  details::line_buffer buffer_;
+};
+
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace csv {
+
+// Read-only memory mapping of a whole file. Meant to be passed to the
+// csv_iterator(std::string_view) constructor, so that parsed rows point
+// straight into the mapping instead of into a per-line copy.
+class mapped_file {
+ public:
+  mapped_file() noexcept = default;
+
+  explicit mapped_file(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if(fd == -1){
+      throw ::std::system_error(errno, ::std::generic_category(), ::std::string("cannot open ") + path);
+    }
+
+    struct stat file_stat{};
+    if(::fstat(fd, &file_stat) == -1){
+      int error = errno;
+      ::close(fd);
+      throw ::std::system_error(error, ::std::generic_category(), ::std::string("cannot stat ") + path);
+    }
+
+    size_ = static_cast<::std::size_t>(file_stat.st_size);
+    if(size_ != 0){
+      void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(mapping == MAP_FAILED){
+        int error = errno;
+        ::close(fd);
+        throw ::std::system_error(error, ::std::generic_category(), ::std::string("cannot map ") + path);
+      }
+      ::madvise(mapping, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(mapping);
+    }
+    ::close(fd);
+  }
+
+  explicit mapped_file(const ::std::string& path) : mapped_file(path.c_str()) {}
+
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  mapped_file(mapped_file&& rhs) noexcept :
+  data_(::std::exchange(rhs.data_, nullptr)),
+  size_(::std::exchange(rhs.size_, 0)) {}
+
+  mapped_file& operator=(mapped_file&& rhs) noexcept {
+    if(this != &rhs){
+      unmap();
+      data_ = ::std::exchange(rhs.data_, nullptr);
+      size_ = ::std::exchange(rhs.size_, 0);
+    }
+    return *this;
+  }
+
+  ~mapped_file() {
+    unmap();
+  }
+
+  const char* data() const noexcept {
+    return data_;
+  }
+
+  ::std::size_t size() const noexcept {
+    return size_;
+  }
+
+  ::std::string_view view() const noexcept {
+    return ::std::string_view(data_, size_);
+  }
+
+ private:
+  void unmap() noexcept {
+    if(data_) ::munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char* data_ = nullptr;
+  ::std::size_t size_ = 0;
+};
+
+}
@@ -0,0 +1,213 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "csv.hpp"
+
+namespace csv {
+
+constexpr ::std::size_t default_chunk_size = ::std::size_t(1) << 22;
+
+namespace details {
+
+// Returns offset of the first line starting at or after position.
+inline ::std::size_t line_start_at_or_after(::std::string_view buffer, ::std::size_t position) noexcept {
+  if(position == 0) return 0;
+  if(position >= buffer.size()) return buffer.size();
+
+  auto* newline = static_cast<const char*>(::std::memchr(buffer.data() + position - 1, '\n', buffer.size() - position + 1));
+  return newline ? static_cast<::std::size_t>(newline - buffer.data()) + 1 : buffer.size();
+}
+
+// Chunks are cut at fixed byte offsets, each moved forward to the next line start. Every thread computes
+// boundaries of the chunks it processes by itself, so there is no sequential pass over the buffer.
+inline ::std::string_view chunk(::std::string_view buffer, ::std::size_t index, ::std::size_t chunk_size) noexcept {
+  auto begin = line_start_at_or_after(buffer, index * chunk_size);
+  auto end = line_start_at_or_after(buffer, (index + 1) * chunk_size);
+  return buffer.substr(begin, end - begin);
+}
+
+inline unsigned thread_count(unsigned threads) noexcept {
+  if(threads != 0) return threads;
+  return ::std::max(1u, ::std::thread::hardware_concurrency());
+}
+
+// Runs work on the given number of additional threads and caller_work on the calling one.
+// Rethrows the first exception thrown by any of them, once all of them finish.
+template<typename Work, typename CallerWork>
+void run_on_threads(unsigned threads, Work&& work, CallerWork&& caller_work) {
+  ::std::exception_ptr error;
+  ::std::mutex error_mutex;
+  auto guard = [&](auto& function){
+    try {
+      function();
+    } catch(...) {
+      ::std::lock_guard<::std::mutex> lock(error_mutex);
+      if(!error) error = ::std::current_exception();
+    }
+  };
+
+  ::std::vector<::std::thread> workers;
+  workers.reserve(threads);
+  for(unsigned i = 0; i < threads; ++i) workers.emplace_back([&]{ guard(work); });
+  guard(caller_work);
+  for(auto& worker : workers) worker.join();
+
+  if(error) ::std::rethrow_exception(error);
+}
+
+}
+
+// Parses buffer on multiple threads. The buffer is split into chunks of roughly chunk_size bytes, which
+// threads take one by one, so that threads finishing early keep taking work from the slower ones.
+// callback is called concurrently, once per chunk, with csv_iterator over all rows of that chunk.
+// threads equal to 0 means one thread per hardware core.
+template<std::size_t rows, bool check_correctness = false, typename Callback>
+void parallel_for_each_batch(::std::string_view buffer, Callback&& callback, char delimiter = ',',
+                             unsigned threads = 0, ::std::size_t chunk_size = default_chunk_size) {
+  chunk_size = ::std::max<::std::size_t>(chunk_size, 1);
+  const ::std::size_t chunks = (buffer.size() + chunk_size - 1) / chunk_size;
+  ::std::atomic<::std::size_t> next_chunk{0};
+  ::std::atomic<bool> failed{false};
+
+  auto work = [&]{
+    try {
+      for(auto index = next_chunk++; index < chunks && !failed; index = next_chunk++){
+        auto current_chunk = details::chunk(buffer, index, chunk_size);
+        if(current_chunk.empty()) continue;
+        callback(csv_iterator<rows, check_correctness>(current_chunk, delimiter));
+      }
+    } catch(...) {
+      failed = true;
+      throw;
+    }
+  };
+
+  details::run_on_threads(details::thread_count(threads) - 1, work, work);
+}
+
+// Same as parallel_for_each_batch, but callback is called concurrently for every row. Order of the rows is unspecified.
+template<std::size_t rows, bool check_correctness = false, typename Callback>
+void parallel_for_each(::std::string_view buffer, Callback&& callback, char delimiter = ',',
+                       unsigned threads = 0, ::std::size_t chunk_size = default_chunk_size) {
+  parallel_for_each_batch<rows, check_correctness>(buffer, [&callback](csv_iterator<rows, check_correctness> rows_begin){
+    for(auto& row : rows_begin) callback(row);
+  }, delimiter, threads, chunk_size);
+}
+
+// Parses buffer on worker threads, but calls callback for every row in file order, from the calling thread.
+// At most two chunks per worker are parsed ahead of the row being delivered. Rows of dynamic_width are not supported.
+template<std::size_t rows, bool check_correctness = false, typename Callback>
+void parallel_for_each_ordered(::std::string_view buffer, Callback&& callback, char delimiter = ',',
+                               unsigned threads = 0, ::std::size_t chunk_size = default_chunk_size) {
+  // rows are kept until delivered, while row_views of dynamic_width refer to storage of the parsing iterator
+  static_assert(rows != dynamic_width, "rows of dynamic_width can be parsed in parallel only by parallel_for_each(_batch)");
+  using iterator = csv_iterator<rows, check_correctness>;
+  using row_type = typename iterator::value_type;
+
+  chunk_size = ::std::max<::std::size_t>(chunk_size, 1);
+  const ::std::size_t chunks = (buffer.size() + chunk_size - 1) / chunk_size;
+  const unsigned workers_count = details::thread_count(threads);
+  const ::std::size_t window = 2 * ::std::size_t(workers_count);
+
+  ::std::vector<::std::vector<row_type>> parsed(window);
+  ::std::vector<char> ready(window, false);
+  ::std::mutex mutex;
+  ::std::condition_variable state_changed;
+  ::std::size_t next_chunk = 0;
+  ::std::size_t delivered = 0;
+  bool failed = false;
+
+  auto fail = [&]{
+    ::std::lock_guard<::std::mutex> lock(mutex);
+    failed = true;
+    state_changed.notify_all();
+  };
+
+  auto worker = [&]{
+    try {
+      for(;;){
+        ::std::size_t index;
+        {
+          ::std::unique_lock<::std::mutex> lock(mutex);
+          state_changed.wait(lock, [&]{ return failed || next_chunk >= chunks || next_chunk < delivered + window; });
+          if(failed || next_chunk >= chunks) return;
+          index = next_chunk++;
+        }
+
+        auto& slot = parsed[index % window];
+        for(auto& row : iterator(details::chunk(buffer, index, chunk_size), delimiter)) slot.push_back(row);
+
+        ::std::lock_guard<::std::mutex> lock(mutex);
+        ready[index % window] = true;
+        state_changed.notify_all();
+      }
+    } catch(...) {
+      fail();
+      throw;
+    }
+  };
+
+  auto deliver = [&]{
+    try {
+      for(::std::size_t index = 0; index < chunks; ++index){
+        {
+          ::std::unique_lock<::std::mutex> lock(mutex);
+          state_changed.wait(lock, [&]{ return failed || ready[index % window]; });
+          if(failed) return;
+        }
+
+        auto& slot = parsed[index % window];
+        for(auto& row : slot) callback(row);
+        slot.clear();
+
+        ::std::lock_guard<::std::mutex> lock(mutex);
+        ready[index % window] = false;
+        ++delivered;
+        state_changed.notify_all();
+      }
+    } catch(...) {
+      fail();
+      throw;
+    }
+  };
+
+  details::run_on_threads(workers_count, worker, deliver);
+}
+
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "csv.hpp"
+
+namespace csv {
+
+namespace details {
+
+// Blocks a thread until a condition on atomics holds. Conditions are polled for a while first,
+// the mutex is touched only when the waiting thread goes to sleep, so notify is a single atomic
+// load, when nobody sleeps. Conditions have to use sequentially consistent atomic operations.
+class waiter {
+ public:
+  template<typename Condition>
+  void wait(Condition condition) {
+    for(int attempt = 0; attempt < 64; ++attempt){
+      if(condition()) return;
+      ::std::this_thread::yield();
+    }
+
+    ::std::unique_lock<::std::mutex> lock(mutex_);
+    sleeping_ = true;
+    woken_.wait(lock, condition);
+    sleeping_ = false;
+  }
+
+  void notify() {
+    if(!sleeping_) return;
+    ::std::lock_guard<::std::mutex> lock(mutex_);
+    woken_.notify_all();
+  }
+
+ private:
+  ::std::atomic<bool> sleeping_{false};
+  ::std::mutex mutex_;
+  ::std::condition_variable woken_;
+};
+
+}
+
+// Reads a stream on a dedicated thread into a ring of buffers ahead of parsing, so that reading
+// and parsing overlap. Buffers are handed over to the parsing thread without locks, the reading
+// thread only blocks when all of them are filled and not parsed yet. Lines crossing the buffer
+// boundary are copied into a separate buffer, all the others are parsed in place.
+// The destructor waits for the read in progress to finish.
+class prefetch_reader : public line_reader {
+ public:
+  static constexpr ::std::size_t default_buffers = 4;
+  static constexpr ::std::size_t default_buffer_size = ::std::size_t(1) << 20;
+
+  explicit prefetch_reader(::std::istream& stream, ::std::size_t buffers = default_buffers,
+                           ::std::size_t buffer_size = default_buffer_size) :
+  stream_(&stream),
+  buffer_size_(::std::max<::std::size_t>(buffer_size, 1)),
+  buffers_(::std::max<::std::size_t>(buffers, 2)) {
+    for(auto& slot : buffers_) slot.data.reset(new char[buffer_size_]);
+    reading_thread_ = ::std::thread([this]{ read(); });
+  }
+
+  prefetch_reader(const prefetch_reader&) = delete;
+  prefetch_reader& operator=(const prefetch_reader&) = delete;
+
+  ~prefetch_reader() override {
+    stopped_ = true;
+    buffer_released_.notify();
+    reading_thread_.join();
+  }
+
+  ::std::string_view next_lines() override {
+    if(carry_returned_){
+      carry_.clear();
+      carry_returned_ = false;
+    }
+
+    for(;;){
+      if(held_){
+        if(!rest_.empty()){
+          auto last_newline = rest_.rfind('\n');
+          if(last_newline != ::std::string_view::npos){
+            auto lines = rest_.substr(0, last_newline + 1);
+            rest_.remove_prefix(last_newline + 1);
+            return lines;
+          }
+          // beginning of a line, that continues in the next buffer
+          carry_.append(rest_.data(), rest_.size());
+        }
+        release();
+      }
+
+      if(!acquire()){
+        if(carry_.empty()) return {};
+        carry_returned_ = true;
+        return carry_;
+      }
+
+      if(!carry_.empty()){
+        auto first_newline = rest_.find('\n');
+        auto head = rest_.substr(0, first_newline == ::std::string_view::npos ? rest_.size() : first_newline + 1);
+        carry_.append(head.data(), head.size());
+        rest_.remove_prefix(head.size());
+        if(first_newline != ::std::string_view::npos){
+          carry_returned_ = true;
+          return carry_;
+        }
+      }
+    }
+  }
+
+ private:
+  struct buffer {
+    ::std::unique_ptr<char[]> data;
+    ::std::size_t size = 0;
+  };
+
+  // reading thread
+  void read() {
+    for(::std::size_t produced = 0;; ++produced){
+      buffer_released_.wait([&]{ return stopped_ || produced - consumed_ < buffers_.size(); });
+      if(stopped_) return;
+
+      auto& current = buffers_[produced % buffers_.size()];
+      try {
+        current.size = static_cast<::std::size_t>(stream_->rdbuf()->sgetn(current.data.get(), static_cast<::std::streamsize>(buffer_size_)));
+      } catch(...) {
+        error_ = ::std::current_exception();
+        current.size = 0;
+      }
+
+      produced_ = produced + 1;
+      buffer_filled_.notify();
+      if(current.size == 0) return; // end of the stream
+    }
+  }
+
+  // Takes the next filled buffer, returns false at the end of the stream.
+  bool acquire() {
+    if(finished_) return false;
+
+    buffer_filled_.wait([&]{ return produced_ != taken_; });
+    auto& current = buffers_[taken_ % buffers_.size()];
+    if(current.size == 0){
+      finished_ = true;
+      if(error_) ::std::rethrow_exception(error_);
+      return false;
+    }
+
+    held_ = true;
+    rest_ = ::std::string_view(current.data.get(), current.size);
+    return true;
+  }
+
+  void release() {
+    held_ = false;
+    consumed_ = ++taken_;
+    buffer_released_.notify();
+  }
+
+  ::std::istream* stream_;
+  ::std::size_t buffer_size_;
+  ::std::vector<buffer> buffers_;
+
+  // counters of buffers filled by the reading thread and released by the parsing one
+  ::std::atomic<::std::size_t> produced_{0};
+  ::std::atomic<::std::size_t> consumed_{0};
+  ::std::atomic<bool> stopped_{false};
+  details::waiter buffer_filled_;
+  details::waiter buffer_released_;
+  ::std::exception_ptr error_;
+
+  // state of the parsing thread
+  ::std::size_t taken_ = 0;
+  bool held_ = false;
+  bool finished_ = false;
+  ::std::string_view rest_;
+  ::std::string carry_;
+  bool carry_returned_ = false;
+
+  ::std::thread reading_thread_;
+};
+
+}
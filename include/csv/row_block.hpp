@@ -0,0 +1,167 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include "csv.hpp"
+#include "typed_iterator.hpp"
+
+namespace csv {
+
+// Fields of up to capacity rows stored column by column. For every column there is a contiguous array
+// of offsets (relative to base()) and a contiguous array of lengths of its fields. Storage is allocated
+// once, so the block can be refilled by block_parser without allocations.
+template<std::size_t rows_>
+class row_block {
+ public:
+  static constexpr std::size_t rows = rows_;
+
+  explicit row_block(::std::size_t capacity = 4096) : capacity_(capacity) {
+    for(auto& column : offsets_) column.resize(capacity);
+    for(auto& column : lengths_) column.resize(capacity);
+  }
+
+  // number of rows in the block
+  ::std::size_t size() const noexcept {
+    return size_;
+  }
+
+  ::std::size_t capacity() const noexcept {
+    return capacity_;
+  }
+
+  bool empty() const noexcept {
+    return size_ == 0;
+  }
+
+  const char* base() const noexcept {
+    return base_;
+  }
+
+  const ::std::uint32_t* offsets(::std::size_t column) const noexcept {
+    return offsets_[column].data();
+  }
+
+  const ::std::uint32_t* lengths(::std::size_t column) const noexcept {
+    return lengths_[column].data();
+  }
+
+  ::std::string_view field(::std::size_t row, ::std::size_t column) const noexcept {
+    return ::std::string_view(base_ + offsets_[column][row], lengths_[column][row]);
+  }
+
+  // Converts fields of the column with field_parser into values, resized to size() (so reusing the
+  // vector across blocks does not allocate). Returns false if any of the fields could not be converted.
+  template<typename T>
+  bool convert(::std::size_t column, ::std::vector<T>& values) const {
+    values.resize(size_);
+    bool converted = true;
+    for(::std::size_t row = 0; row < size_; ++row){
+      converted &= field_parser<T>::parse(field(row, column), values[row]);
+    }
+    return converted;
+  }
+
+ private:
+  template<std::size_t, bool, typename...>
+  friend class block_parser;
+
+  ::std::size_t capacity_;
+  ::std::size_t size_ = 0;
+  const char* base_ = nullptr;
+  ::std::array<::std::vector<::std::uint32_t>, rows> offsets_;
+  ::std::array<::std::vector<::std::uint32_t>, rows> lengths_;
+};
+
+// Parses contiguous content into row_blocks, as many rows at once as the block can hold.
+// Rows are split one by one by csv_iterator with the same arguments, so parsing itself is not batched:
+// the block is a columnar layout of its results for the code consuming them. With the columns option
+// the block holds only the selected columns.
+template<std::size_t rows, bool check_correctness = false, typename... options>
+class block_parser {
+  static_assert(!details::has_option<rfc4180, options...>,
+                "block_parser refers to fields by offsets into the content, so it cannot hold unescaped quoted fields");
+  static_assert(rows != dynamic_width, "row_block holds a fixed number of columns, so rows cannot be of dynamic_width");
+  using iterator = csv_iterator<rows, check_correctness, options...>;
+  static constexpr std::size_t fields = iterator::fields;
+  static constexpr bool projected = details::projection<options...>::enabled;
+ public:
+  explicit block_parser(::std::string_view buffer, char delimiter = ',') :
+  current_(buffer, delimiter) {}
+
+  // Replaces content of the block with the following rows, returns number of them (0 at the end of content).
+  ::std::size_t next(row_block<fields>& block) {
+    block.size_ = 0;
+    if(current_ == iterator{}) return 0;
+
+    // selected columns may be listed in any order, the base is the first field of the first row in the content,
+    // which precedes fields of all the following rows
+    block.base_ = first_field(*current_);
+    const ::std::size_t max_offset = ::std::numeric_limits<::std::uint32_t>::max();
+    for(; block.size_ != block.capacity_ && current_ != iterator{}; ++current_, ++block.size_){
+      auto& row = *current_;
+      // rows, that are not addressable by 32 bit offsets from the base, go to the next block
+      if(static_cast<::std::size_t>(row_end(row) - block.base_) > max_offset && block.size_ != 0) break;
+
+      for(::std::size_t column = 0; column != fields; ++column){
+        block.offsets_[column][block.size_] = static_cast<::std::uint32_t>(row[column].data() - block.base_);
+        block.lengths_[column][block.size_] = static_cast<::std::uint32_t>(row[column].size());
+      }
+    }
+    return block.size_;
+  }
+
+ private:
+  // without the columns option fields are in the order of the content
+  static const char* first_field(const typename iterator::value_type& row) noexcept {
+    if constexpr (!projected) return row[0].data();
+    auto first = ::std::min_element(row.begin(), row.end(), [](::std::string_view lhs, ::std::string_view rhs){
+      return ::std::less<const char*>{}(lhs.data(), rhs.data());
+    });
+    return first->data();
+  }
+
+  static const char* row_end(const typename iterator::value_type& row) noexcept {
+    if constexpr (!projected) return row[fields - 1].data() + row[fields - 1].size();
+    auto last = ::std::max_element(row.begin(), row.end(), [](::std::string_view lhs, ::std::string_view rhs){
+      return ::std::less<const char*>{}(lhs.data() + lhs.size(), rhs.data() + rhs.size());
+    });
+    return last->data() + last->size();
+  }
+
+  iterator current_;
+};
+
+}
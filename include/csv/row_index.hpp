@@ -0,0 +1,171 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "csv.hpp"
+
+namespace csv {
+
+// Index of line start offsets of csv content, that allows to start parsing at any row without
+// reading the content before it. Only every sampling-th offset is stored, the remaining are found
+// by skipping at most sampling - 1 lines from the closest stored one. Rows are lines terminated by
+// a newline, so content with quoted newlines is not supported. The index can be saved next to the
+// content and updated when more content is appended to it.
+class row_index {
+ public:
+  static constexpr ::std::size_t default_sampling = 4096;
+
+  explicit row_index(::std::size_t sampling = default_sampling) :
+  sampling_(::std::max<::std::size_t>(sampling, 1)),
+  samples_{0} {}
+
+  // Indexes rows of content, that were not indexed yet. Content has to start with the content
+  // indexed before, e.g. it is the same file after more lines were appended. An unterminated last
+  // line is not indexed, until its newline is appended.
+  void update(::std::string_view content) {
+    if(content.size() < indexed_bytes_) throw csv_error("csv content is shorter than its index.");
+
+    auto* data = content.data();
+    auto* end = content.data() + content.size();
+    auto* position = data + indexed_bytes_;
+    while(auto* newline = static_cast<const char*>(::std::memchr(position, '\n', end - position))){
+      position = newline + 1;
+      if(++rows_ % sampling_ == 0) samples_.push_back(static_cast<::std::uint64_t>(position - data));
+    }
+    indexed_bytes_ = static_cast<::std::size_t>(position - data);
+  }
+
+  // number of indexed rows
+  ::std::size_t rows() const noexcept {
+    return rows_;
+  }
+
+  // size of the indexed part of the content, i.e. offset right after the last indexed row
+  ::std::size_t indexed_bytes() const noexcept {
+    return indexed_bytes_;
+  }
+
+  ::std::size_t sampling() const noexcept {
+    return sampling_;
+  }
+
+  // Returns offset in content of the row-th row (counting from 0). Row equal to rows() refers to the
+  // end of the indexed content.
+  ::std::size_t offset(::std::string_view content, ::std::size_t row) const {
+    if(row > rows_) throw ::std::out_of_range("row is not indexed.");
+
+    auto* data = content.data();
+    auto* position = data + samples_[row / sampling_];
+    for(auto skip = row % sampling_; skip != 0; --skip){
+      position = static_cast<const char*>(::std::memchr(position, '\n', content.size() - (position - data))) + 1;
+    }
+    return static_cast<::std::size_t>(position - data);
+  }
+
+  // Returns content starting at the row-th row, to create csv_iterator beginning there.
+  ::std::string_view seek(::std::string_view content, ::std::size_t row) const {
+    return content.substr(offset(content, row));
+  }
+
+  // Splits the indexed content into at most parts ranges of similar number of rows, for parsing them
+  // in parallel. Returns offsets of the range boundaries, starting with 0 and ending with indexed_bytes().
+  // Boundaries are chosen from the stored offsets, so the content is not read.
+  ::std::vector<::std::size_t> split_points(::std::size_t parts) const {
+    ::std::vector<::std::size_t> points{0};
+    auto samples = samples_.size();
+    for(::std::size_t part = 1; part < parts; ++part){
+      auto point = static_cast<::std::size_t>(samples_[part * samples / parts]);
+      if(point != points.back() && point < indexed_bytes_) points.push_back(point);
+    }
+    if(indexed_bytes_ != 0) points.push_back(indexed_bytes_);
+    return points;
+  }
+
+  // Index is stored as little endian 64 bit numbers: magic, version, sampling, rows, indexed bytes and offsets.
+  void save(const ::std::string& path) const {
+    ::std::ofstream file(path, ::std::ios::binary | ::std::ios::trunc);
+    write(file, magic);
+    write(file, version);
+    write(file, sampling_);
+    write(file, rows_);
+    write(file, indexed_bytes_);
+    for(auto sample : samples_) write(file, sample);
+    if(!file.flush()) throw csv_error("cannot write csv index file " + path + ".");
+  }
+
+  static row_index load(const ::std::string& path) {
+    ::std::ifstream file(path, ::std::ios::binary);
+    if(!file) throw csv_error("cannot open csv index file " + path + ".");
+
+    if(read(file) != magic || read(file) != version) throw csv_error("corrupted csv index file " + path + ".");
+    row_index index(static_cast<::std::size_t>(read(file)));
+    index.rows_ = static_cast<::std::size_t>(read(file));
+    index.indexed_bytes_ = static_cast<::std::size_t>(read(file));
+    index.samples_.resize(index.rows_ / index.sampling_ + 1);
+    for(auto& sample : index.samples_) sample = read(file);
+    if(!file || index.samples_.front() != 0) throw csv_error("corrupted csv index file " + path + ".");
+    return index;
+  }
+
+ private:
+  static constexpr ::std::uint64_t magic = 0x5845444E49565343; // "CSVINDEX"
+  static constexpr ::std::uint64_t version = 1;
+
+  static void write(::std::ostream& stream, ::std::uint64_t value) {
+    char bytes[8];
+    for(auto& byte : bytes){
+      byte = static_cast<char>(value & 0xff);
+      value >>= 8;
+    }
+    stream.write(bytes, sizeof(bytes));
+  }
+
+  static ::std::uint64_t read(::std::istream& stream) {
+    unsigned char bytes[8] = {};
+    stream.read(reinterpret_cast<char*>(bytes), sizeof(bytes));
+    ::std::uint64_t value = 0;
+    for(int i = 7; i >= 0; --i) value = (value << 8) | bytes[i];
+    return value;
+  }
+
+  ::std::size_t sampling_;
+  ::std::vector<::std::uint64_t> samples_; // offsets of rows 0, sampling, 2 * sampling, ...
+  ::std::size_t rows_ = 0;
+  ::std::size_t indexed_bytes_ = 0;
+};
+
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "csv.hpp"
+
+namespace csv {
+
+// Converts a field into value of type T. parse returns false, when the field is not a valid T.
+// Specialize it to read columns of own types (e.g. dates) with csv_typed_iterator.
+template<typename T, typename = void>
+struct field_parser;
+
+template<typename T>
+struct field_parser<T, ::std::enable_if_t<::std::is_arithmetic_v<T> && !::std::is_same_v<T, bool>>> {
+  static bool parse(::std::string_view field, T& value) noexcept {
+    auto* end = field.data() + field.size();
+    auto [parsed_end, error] = ::std::from_chars(field.data(), end, value);
+    return error == ::std::errc{} && parsed_end == end;
+  }
+};
+
+template<>
+struct field_parser<bool> {
+  static bool parse(::std::string_view field, bool& value) noexcept {
+    if(field == "1" || field == "true") value = true;
+    else if(field == "0" || field == "false") value = false;
+    else return false;
+    return true;
+  }
+};
+
+template<>
+struct field_parser<::std::string_view> {
+  static bool parse(::std::string_view field, ::std::string_view& value) noexcept {
+    value = field;
+    return true;
+  }
+};
+
+namespace details {
+
+template<bool check_correctness, typename T>
+bool convert_field(::std::string_view field, T& value) {
+  bool converted = field_parser<T>::parse(field, value);
+  return !check_correctness || converted;
+}
+
+}
+
+// Iterator over rows converted to the column types of Tuple, e.g.
+// csv_typed_iterator<std::tuple<int64_t, double, std::string_view>>. Fields are split by csv_iterator
+// and converted in place by field_parser of every column, chosen at compile time. In checked mode
+// rows with fields that cannot be converted are handled as malformed lines of csv_iterator: they are
+// reported with csv_error, or skipped with errc::invalid_field under skip_errors or report_errors option.
+// In unchecked mode value of such fields is unspecified.
+template<typename Tuple, bool check_correctness = false, typename... options>
+class csv_typed_iterator;
+
+template<typename... Types, bool check_correctness, typename... options>
+class csv_typed_iterator<::std::tuple<Types...>, check_correctness, options...> {
+  using fields_iterator = csv_iterator<sizeof...(Types), check_correctness, options...>;
+  static_assert(fields_iterator::fields == sizeof...(Types),
+                "csv_typed_iterator needs a type for every column, so columns cannot be selected");
+ public:
+  using iterator_category = ::std::input_iterator_tag;
+  using value_type = ::std::tuple<Types...>;
+  using pointer = const value_type*;
+  using reference = const value_type&;
+  using difference_type = std::ptrdiff_t;
+  using error_handler_type = typename fields_iterator::error_handler_type;
+
+  csv_typed_iterator() = default;
+
+  explicit csv_typed_iterator(std::istream& stream, char delimiter = ',', std::size_t columns = sizeof...(Types),
+                              error_handler_type on_error = {}) :
+  fields_(stream, delimiter, columns, ::std::move(on_error)) {
+    convert();
+  }
+
+  explicit csv_typed_iterator(std::string_view buffer, char delimiter = ',', std::size_t columns = sizeof...(Types),
+                              error_handler_type on_error = {}) :
+  fields_(buffer, delimiter, columns, ::std::move(on_error)) {
+    convert();
+  }
+
+  explicit csv_typed_iterator(line_reader& reader, char delimiter = ',', std::size_t columns = sizeof...(Types),
+                              error_handler_type on_error = {}) :
+  fields_(reader, delimiter, columns, ::std::move(on_error)) {
+    convert();
+  }
+
+  // With report_errors option, the number of columns can be left out, when passing on_error.
+  template<bool enabled = details::has_option<report_errors, options...>, typename = ::std::enable_if_t<enabled>>
+  csv_typed_iterator(std::istream& stream, char delimiter, error_handler_type on_error) :
+  csv_typed_iterator(stream, delimiter, sizeof...(Types), ::std::move(on_error)) {}
+
+  template<bool enabled = details::has_option<report_errors, options...>, typename = ::std::enable_if_t<enabled>>
+  csv_typed_iterator(std::string_view buffer, char delimiter, error_handler_type on_error) :
+  csv_typed_iterator(buffer, delimiter, sizeof...(Types), ::std::move(on_error)) {}
+
+  template<bool enabled = details::has_option<report_errors, options...>, typename = ::std::enable_if_t<enabled>>
+  csv_typed_iterator(line_reader& reader, char delimiter, error_handler_type on_error) :
+  csv_typed_iterator(reader, delimiter, sizeof...(Types), ::std::move(on_error)) {}
+
+  csv_typed_iterator(const csv_typed_iterator& rhs) :
+  fields_(rhs.fields_),
+  result_(rhs.result_) {
+    update_views();
+  }
+
+  csv_typed_iterator(csv_typed_iterator&& rhs) noexcept :
+  fields_(std::move(rhs.fields_)),
+  result_(std::move(rhs.result_)) {
+    update_views();
+  }
+
+  csv_typed_iterator& operator=(const csv_typed_iterator& rhs){
+    fields_ = rhs.fields_;
+    result_ = rhs.result_;
+    update_views();
+    return *this;
+  }
+
+  csv_typed_iterator& operator=(csv_typed_iterator&& rhs){
+    fields_ = std::move(rhs.fields_);
+    result_ = std::move(rhs.result_);
+    update_views();
+    return *this;
+  }
+
+  ~csv_typed_iterator() = default;
+
+  reference operator*() const {
+    return result_;
+  }
+
+  pointer operator->() const {
+    return &result_;
+  }
+
+  // Malformed lines and rows that could not be converted skipped so far, available with skip_errors or report_errors option.
+  const error_report& errors() const noexcept {
+    return fields_.errors();
+  }
+
+  csv_typed_iterator& operator++() {
+    ++fields_;
+    convert();
+    return *this;
+  }
+
+  csv_typed_iterator operator++(int) {
+    csv_typed_iterator previous = *this;
+    ++(*this);
+    return std::move(previous);
+  }
+
+ private:
+  // rows that cannot be converted are rejected by the fields iterator, which throws or moves to the next row
+  void convert() {
+    while(fields_ != fields_iterator{} && !convert(::std::index_sequence_for<Types...>{})) {
+      fields_.reject(errc::invalid_field);
+    }
+  }
+
+  template<std::size_t... columns>
+  bool convert(::std::index_sequence<columns...>) {
+    return (details::convert_field<check_correctness>((*fields_)[columns], ::std::get<columns>(result_)) && ...);
+  }
+
+  // only string_view columns refer to the memory of the fields iterator, point them into the own one
+  void update_views() noexcept {
+    if(fields_ == fields_iterator{}) return;
+    update_views(::std::index_sequence_for<Types...>{});
+  }
+
+  template<std::size_t... columns>
+  void update_views(::std::index_sequence<columns...>) noexcept {
+    (update_view((*fields_)[columns], ::std::get<columns>(result_)), ...);
+  }
+
+  template<typename T>
+  static void update_view(::std::string_view field, T& value) noexcept {
+    if constexpr (::std::is_same_v<T, ::std::string_view>) value = field;
+  }
+
+  friend bool operator==(const csv_typed_iterator& lhs, const csv_typed_iterator& rhs) {
+    return lhs.fields_ == rhs.fields_;
+  }
+
+  friend bool operator!=(const csv_typed_iterator& lhs, const csv_typed_iterator& rhs) {
+    return !(lhs == rhs);
+  }
+
+  friend csv_typed_iterator& begin(csv_typed_iterator& iterator){
+    return iterator;
+  }
+
+  friend csv_typed_iterator begin(const csv_typed_iterator& iterator){
+    return iterator;
+  }
+
+  friend csv_typed_iterator end(const csv_typed_iterator&){
+    return csv_typed_iterator{};
+  }
+
+  fields_iterator fields_;
+  value_type result_;
+};
+
+}
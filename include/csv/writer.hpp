@@ -0,0 +1,253 @@
+/*
+ * Copyright 2020 dawid.pilarski@panicsoftware.com
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CSV_ITERATOR_HAS_POSIX
+#include <unistd.h>
+#endif
+
+#include "csv.hpp"
+
+namespace csv {
+
+// Memory, that field_formatter may write the text of a field into.
+using field_storage = ::std::array<char, 64>;
+
+// Converts value of type T into the text of a field, which may be written into storage. Specialize it
+// to write columns of own types (e.g. dates) with csv_writer. It is the counterpart of field_parser.
+template<typename T, typename = void>
+struct field_formatter;
+
+template<typename T>
+struct field_formatter<T, ::std::enable_if_t<::std::is_arithmetic_v<T> && !::std::is_same_v<T, bool>>> {
+  static ::std::string_view format(T value, field_storage& storage) noexcept {
+    // 64 characters fit the shortest representation of any integer or floating point value
+    auto [end, error] = ::std::to_chars(storage.data(), storage.data() + storage.size(), value);
+    (void)error;
+    return ::std::string_view(storage.data(), static_cast<::std::size_t>(end - storage.data()));
+  }
+};
+
+template<>
+struct field_formatter<bool> {
+  static ::std::string_view format(bool value, field_storage&) noexcept {
+    return value ? "true" : "false";
+  }
+};
+
+template<typename T>
+struct field_formatter<T, ::std::enable_if_t<::std::is_convertible_v<const T&, ::std::string_view>>> {
+  static ::std::string_view format(const T& value, field_storage&) noexcept {
+    return value;
+  }
+};
+
+// Writes csv rows of rows columns into a large reusable buffer, which is written out to a file descriptor or
+// a stream only when it is full, on flush and on destruction. Fields are quoted following RFC 4180 only when
+// they contain the delimiter, a quote or a line end, so the content can be read back by csv_iterator, with
+// the rfc4180 option if any field was quoted. Rows are terminated with '\n'.
+template<std::size_t rows>
+class csv_writer {
+  static_assert(rows >= 1, "csv_writer needs to write rows, that have at least one column");
+ public:
+  static constexpr ::std::size_t default_buffer_size = ::std::size_t(1) << 20;
+
+  explicit csv_writer(::std::ostream& stream, char delimiter = ',', ::std::size_t buffer_size = default_buffer_size) :
+  stream_(&stream),
+  delimiter_(delimiter),
+  capacity_(::std::max<::std::size_t>(buffer_size, field_storage{}.size())),
+  buffer_(new char[capacity_]) {}
+
+#ifdef CSV_ITERATOR_HAS_POSIX
+  // Writes to a file descriptor, that stays owned by the caller (POSIX only).
+  explicit csv_writer(int fd, char delimiter = ',', ::std::size_t buffer_size = default_buffer_size) :
+  fd_(fd),
+  delimiter_(delimiter),
+  capacity_(::std::max<::std::size_t>(buffer_size, field_storage{}.size())),
+  buffer_(new char[capacity_]) {}
+#endif
+
+  csv_writer(const csv_writer&) = delete;
+  csv_writer& operator=(const csv_writer&) = delete;
+
+  csv_writer(csv_writer&& rhs) noexcept :
+  stream_(rhs.stream_),
+  fd_(rhs.fd_),
+  delimiter_(rhs.delimiter_),
+  capacity_(rhs.capacity_),
+  buffer_(::std::move(rhs.buffer_)),
+  size_(::std::exchange(rhs.size_, 0)) {}
+
+  csv_writer& operator=(csv_writer&&) = delete;
+
+  // Errors of writing out the rest of the buffer are ignored here, call flush to detect them.
+  ~csv_writer() {
+    try {
+      flush();
+    } catch(...) {
+    }
+  }
+
+  void write(const ::std::array<::std::string_view, rows>& row) {
+    for(::std::size_t column = 0; column != rows; ++column) {
+      write_field(row[column], column + 1 == rows ? '\n' : delimiter_);
+    }
+  }
+
+  // Writes a row of values of any types supported by field_formatter, e.g. write(std::tie(id, value, name)).
+  template<typename... Types>
+  void write(const ::std::tuple<Types...>& row) {
+    static_assert(sizeof...(Types) == rows, "written tuple needs to have rows elements");
+    write(row, ::std::index_sequence_for<Types...>{});
+  }
+
+  // Writes out the buffered rows. When writing to a file descriptor fails, the part, that was not written yet,
+  // stays buffered, so flush can be retried without repeating content. Streams do not tell how much of a failed
+  // write reached them, so the buffer is dropped then.
+  void flush() {
+    if(size_ == 0) return;
+#ifdef CSV_ITERATOR_HAS_POSIX
+    if(!stream_) {
+      write_fd();
+      return;
+    }
+#endif
+    bool written = static_cast<bool>(stream_->write(buffer_.get(), static_cast<::std::streamsize>(size_)));
+    size_ = 0;
+    if(!written) throw csv_error("cannot write csv content.");
+  }
+
+ private:
+  template<typename Tuple, ::std::size_t... columns>
+  void write(const Tuple& row, ::std::index_sequence<columns...>) {
+    field_storage storage;
+    (write_field(field_formatter<::std::decay_t<::std::tuple_element_t<columns, Tuple>>>::format(::std::get<columns>(row), storage),
+                 columns + 1 == rows ? '\n' : delimiter_), ...);
+  }
+
+  void write_field(::std::string_view field, char terminator) {
+    if(!needs_quoting(field)) {
+      char* out = reserve(field.size() + 1);
+      ::std::memcpy(out, field.data(), field.size());
+      out[field.size()] = terminator;
+      size_ += field.size() + 1;
+      return;
+    }
+
+    // every character may be a quote, that is doubled
+    char* begin = reserve(field.size() * 2 + 3);
+    char* out = begin;
+    *out++ = details::quote;
+    for(char c : field) {
+      if(c == details::quote) *out++ = details::quote;
+      *out++ = c;
+    }
+    *out++ = details::quote;
+    *out++ = terminator;
+    size_ += static_cast<::std::size_t>(out - begin);
+  }
+
+  bool needs_quoting(::std::string_view field) const noexcept {
+    // 8 characters at a time, checking every byte of a word for each of the special characters
+    ::std::size_t i = 0;
+    for(; i + 8 <= field.size(); i += 8) {
+      ::std::uint64_t word;
+      ::std::memcpy(&word, field.data() + i, 8);
+      if(contains(word, delimiter_) | contains(word, details::quote) | contains(word, '\n') | contains(word, '\r')) return true;
+    }
+    bool special = false;
+    for(; i < field.size(); ++i) {
+      char c = field[i];
+      special |= (c == delimiter_) | (c == details::quote) | (c == '\n') | (c == '\r');
+    }
+    return special;
+  }
+
+  static bool contains(::std::uint64_t word, char c) noexcept {
+    constexpr ::std::uint64_t ones = 0x0101010101010101;
+    ::std::uint64_t matches = word ^ (ones * static_cast<unsigned char>(c));
+    return ((matches - ones) & ~matches & (ones << 7)) != 0;
+  }
+
+  // Returns memory for at least bytes more characters at the end of the buffer.
+  char* reserve(::std::size_t bytes) {
+    if(capacity_ - size_ < bytes) {
+      flush();
+      if(capacity_ < bytes) {
+        // a field longer than the whole buffer
+        capacity_ = bytes;
+        buffer_.reset(new char[capacity_]);
+      }
+    }
+    return buffer_.get() + size_;
+  }
+
+#ifdef CSV_ITERATOR_HAS_POSIX
+  void write_fd() {
+    ::std::size_t written = 0;
+    while(written != size_) {
+      auto result = ::write(fd_, buffer_.get() + written, size_ - written);
+      if(result == -1) {
+        if(errno == EINTR) continue;
+        int error = errno;
+        // keep only what was not written
+        ::std::memmove(buffer_.get(), buffer_.get() + written, size_ - written);
+        size_ -= written;
+        throw ::std::system_error(error, ::std::generic_category(), "cannot write csv content");
+      }
+      written += static_cast<::std::size_t>(result);
+    }
+    size_ = 0;
+  }
+#endif
+
+  ::std::ostream* stream_ = nullptr;
+  int fd_ = -1;
+  char delimiter_;
+  ::std::size_t capacity_;
+  ::std::unique_ptr<char[]> buffer_;
+  ::std::size_t size_ = 0;
+};
+
+}
@@ -27,15 +27,38 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch.hpp>
 #include <csv/csv.hpp>
+#include <csv/block_reader.hpp>
+#include <csv/follow_reader.hpp>
+#include <csv/mapped_file.hpp>
+#include <csv/parallel.hpp>
+#include <csv/prefetch_reader.hpp>
+#include <csv/row_block.hpp>
+#include <csv/row_index.hpp>
+#include <csv/typed_iterator.hpp>
+#include <csv/writer.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <iterator>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace csv;
 
 template <typename T>
 struct check;
 
+// parsed during dynamic initialization, before any scanning kernel might have been selected otherwise
+static const std::size_t statically_parsed_rows = []{
+  std::size_t rows = 0;
+  for(auto& row : csv_iterator<2>(std::string_view{"a,b\nc,d\n"})) rows += row[1].size();
+  return rows;
+}();
+
 TEST_CASE("csv_iterator meets input iterator criteria"){
   std::stringstream ss;
   ss <<
@@ -196,6 +219,869 @@ R"(not|much|to|say
   }
 }
 
+TEST_CASE("Iterating over contiguous buffer"){
+  using sv = std::string_view;
+  std::string content = "a,b\n1,2\n3,4";
+
+  SECTION("string_views point into the buffer and outlive increments"){
+    csv_iterator<2> it(sv{content});
+    auto first = *it;
+    ++it;
+    ++it;
+    CHECK(first == std::array{sv{"a"}, sv{"b"}});
+    CHECK(first[0].data() == content.data());
+    CHECK(*it == std::array{sv{"3"}, sv{"4"}});
+    ++it;
+    CHECK(it == csv_iterator<2>{});
+  }
+
+  SECTION("trailing newline does not produce an additional row"){
+    content += '\n';
+    CHECK(std::distance(csv_iterator<2, true>(sv{content}), csv_iterator<2, true>{}) == 3);
+  }
+
+  SECTION("copies are independent"){
+    csv_iterator<2> it(sv{content});
+    auto copy = it;
+    ++it;
+    CHECK(copy != it);
+    CHECK(*copy == std::array{sv{"a"}, sv{"b"}});
+    CHECK(std::next(copy) == it);
+  }
+
+  SECTION("empty buffer"){
+    CHECK(csv_iterator<2>(sv{}) == csv_iterator<2>{});
+  }
+}
+
+TEST_CASE("Iterating over mapped file"){
+  using sv = std::string_view;
+  std::string path = "csv_iterator_mapped_file_test.csv";
+  {
+    std::ofstream file(path);
+    file << "x|y|z\n1|2|3\n";
+  }
+
+  {
+    mapped_file file(path);
+    CHECK(file.size() == 12);
+    csv_iterator<3> it(file.view(), '|');
+    CHECK(*it == std::array{sv{"x"}, sv{"y"}, sv{"z"}});
+    CHECK(*std::next(it) == std::array{sv{"1"}, sv{"2"}, sv{"3"}});
+    CHECK(std::distance(it, csv_iterator<3>{}) == 2);
+  }
+  std::remove(path.c_str());
+
+  CHECK_THROWS_AS(mapped_file("csv_iterator_file_that_does_not_exist.csv"), std::system_error);
+}
+
+TEST_CASE("Structural scanning"){
+  SECTION("scanning works in static initializers"){
+    CHECK(statically_parsed_rows == 2);
+  }
+
+  using sv = std::string_view;
+
+  SECTION("all match kernels agree with the scalar one"){
+    std::string block(details::block_size, 'x');
+    for(std::size_t i = 0; i < block.size(); i += 3) block[i] = ';';
+    for(std::size_t i = 0; i < block.size(); i += 7) block[i] = '\n';
+    for(std::size_t i = 0; i < block.size(); i += 11) block[i] = '"';
+    block[63] = ';';
+
+    auto check_kernels = [&](auto quoting){
+      constexpr bool with_quotes = decltype(quoting)::value;
+      std::vector<details::match_kernel> kernels{details::active_kernel<with_quotes>()};
+#ifdef CSV_ITERATOR_HAS_SSE2
+      kernels.push_back(details::match_sse2<with_quotes>);
+#endif
+#ifdef CSV_ITERATOR_HAS_AVX2
+      if(__builtin_cpu_supports("avx2")) kernels.push_back(details::match_avx2<with_quotes>);
+#endif
+#ifdef CSV_ITERATOR_HAS_NEON
+      kernels.push_back(details::match_neon<with_quotes>);
+#endif
+
+      auto expected = details::match_scalar<with_quotes>(block.data(), ';');
+      CHECK((expected.delimiters >> 63) == 1);
+      CHECK((expected.quotes != 0) == with_quotes);
+      for(auto kernel : kernels){
+        auto actual = kernel(block.data(), ';');
+        CHECK(actual.delimiters == expected.delimiters);
+        CHECK(actual.newlines == expected.newlines);
+        CHECK(actual.quotes == expected.quotes);
+      }
+    };
+    check_kernels(std::false_type{});
+    check_kernels(std::true_type{});
+  }
+
+  SECTION("prefix xor marks quoted bytes"){
+    CHECK(details::prefix_xor(0b0100010) == 0b0011110);
+    CHECK(details::prefix_xor(std::uint64_t(1) << 63) == std::uint64_t(1) << 63);
+    CHECK(details::prefix_xor(1) == ~std::uint64_t(0));
+  }
+
+  SECTION("lines and fields spanning many blocks"){
+    std::string long_field(150, 'a');
+    std::string content;
+    for(int i = 0; i < 10; ++i){
+      content += long_field + "," + std::to_string(i) + ",b" + std::string(i * 13, 'c') + "\n";
+    }
+
+    int row = 0;
+    for(auto& [first, second, third] : csv_iterator<3, true>(sv{content})){
+      CHECK(first == long_field);
+      CHECK(second == std::to_string(row));
+      CHECK(third == "b" + std::string(row * 13, 'c'));
+      ++row;
+    }
+    CHECK(row == 10);
+
+    std::stringstream ss(content);
+    CHECK(std::distance(csv_iterator<3>(ss), csv_iterator<3>{}) == 10);
+  }
+}
+
+TEST_CASE("Iterating over block reader"){
+  using sv = std::string_view;
+
+  SECTION("lines crossing block boundaries are carried over"){
+    std::string content;
+    for(int i = 0; i < 300; ++i) content += std::to_string(i) + "|" + std::string(i % 40, 'y') + "\n";
+    std::stringstream ss(content);
+    block_reader reader(ss, 16);
+
+    int expected = 0;
+    for(auto& [number, text] : csv_iterator<2, true>(reader, '|')){
+      CHECK(number == std::to_string(expected));
+      CHECK(text.size() == std::size_t(expected % 40));
+      ++expected;
+    }
+    CHECK(expected == 300);
+  }
+
+  SECTION("last line does not need to be terminated"){
+    std::stringstream ss("a,b\nc,d");
+    block_reader reader(ss, 3);
+    csv_iterator<2> it(reader);
+    CHECK(*it == std::array{sv{"a"}, sv{"b"}});
+    CHECK(*++it == std::array{sv{"c"}, sv{"d"}});
+    CHECK(++it == csv_iterator<2>{});
+  }
+
+  SECTION("iterators over the same reader compare equal"){
+    std::stringstream ss("a,b\nc,d\n");
+    block_reader reader(ss);
+    csv_iterator<2> it(reader);
+    auto copy = it;
+    CHECK(copy == it);
+    CHECK(std::distance(it, csv_iterator<2>{}) == 2);
+  }
+
+  SECTION("empty stream"){
+    std::stringstream ss;
+    block_reader reader(ss);
+    CHECK(csv_iterator<2>(reader) == csv_iterator<2>{});
+  }
+}
+
+TEST_CASE("Iterating over prefetch reader"){
+  using sv = std::string_view;
+  std::string content;
+  for(int i = 0; i < 2000; ++i) content += std::to_string(i) + "|" + std::string(i % 50, 'p') + "\n";
+
+  SECTION("rows are read in order regardless of buffer sizes"){
+    for(std::size_t buffer_size : {1, 7, 64, 4096}){
+      for(std::size_t buffers : {2, 3, 8}){
+        std::stringstream ss(content);
+        prefetch_reader reader(ss, buffers, buffer_size);
+        int expected = 0;
+        for(auto& [number, text] : csv_iterator<2, true>(reader, '|')){
+          CHECK(number == std::to_string(expected));
+          CHECK(text.size() == std::size_t(expected % 50));
+          ++expected;
+        }
+        CHECK(expected == 2000);
+      }
+    }
+  }
+
+  SECTION("last line does not need to be terminated"){
+    std::stringstream ss("a,b\nc,d");
+    prefetch_reader reader(ss, 2, 3);
+    csv_iterator<2> it(reader);
+    CHECK(*it == std::array{sv{"a"}, sv{"b"}});
+    CHECK(*++it == std::array{sv{"c"}, sv{"d"}});
+    CHECK(++it == csv_iterator<2>{});
+  }
+
+  SECTION("reader can be destroyed before the stream is read"){
+    std::stringstream ss(content);
+    prefetch_reader reader(ss, 2, 16);
+    CHECK((*csv_iterator<2>(reader, '|'))[0] == "0");
+  }
+}
+
+TEST_CASE("Following growing file"){
+  std::string path = "csv_iterator_follow_test.csv";
+  auto append = [&path](const std::string& content){
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file << content;
+  };
+  auto poll = [](follow_reader& reader){
+    std::vector<std::array<std::string, 2>> rows;
+    for(auto& row : csv_iterator<2, true>(reader)) rows.push_back({std::string(row[0]), std::string(row[1])});
+    return rows;
+  };
+  std::remove(path.c_str());
+  append("a,b\n1,");
+
+  {
+    follow_reader reader(path, 0, 4);
+    CHECK(poll(reader) == std::vector<std::array<std::string, 2>>{{"a", "b"}});
+    CHECK(reader.checkpoint() == 4);
+    CHECK(poll(reader).empty());
+
+    append("2\n3,4\n5,");
+    CHECK(poll(reader) == std::vector<std::array<std::string, 2>>{{"1", "2"}, {"3", "4"}});
+    CHECK(reader.checkpoint() == 12);
+  }
+
+  {
+    follow_reader resumed(path, 12);
+    append("6\n");
+    CHECK(poll(resumed) == std::vector<std::array<std::string, 2>>{{"5", "6"}});
+    CHECK(resumed.checkpoint() == 16);
+    CHECK_THROWS_AS(follow_reader(path, 17), csv_error);
+  }
+  std::remove(path.c_str());
+  CHECK_THROWS_AS(follow_reader(path), csv_error);
+}
+
+TEST_CASE("Quoted fields"){
+  using sv = std::string_view;
+  using quoted_iterator = csv_iterator<3, true, rfc4180>;
+  std::string long_field(100, 'q');
+  std::string content =
+      "plain,\"quoted, with delimiter\",\"with \"\"escaped\"\" quotes\"\n"
+      "\"multi\nline\",\"" + long_field + "\",\"\"\n"
+      "x,\"" + long_field + "\nmore\",\"a\"\"b\"\n";
+
+  auto check_rows = [&](quoted_iterator it){
+    CHECK(*it == std::array{sv{"plain"}, sv{"quoted, with delimiter"}, sv{"with \"escaped\" quotes"}});
+    ++it;
+    CHECK(*it == std::array{sv{"multi\nline"}, sv{long_field}, sv{""}});
+    auto copy = it;
+    ++it;
+    CHECK(*it == std::array{sv{"x"}, sv{long_field + "\nmore"}, sv{"a\"b"}});
+    auto moved = std::move(it);
+    CHECK((*moved)[2] == "a\"b");
+    ++moved;
+    CHECK(moved == quoted_iterator{});
+    (void)copy;
+  };
+
+  SECTION("contiguous buffer"){
+    check_rows(quoted_iterator(sv{content}));
+  }
+
+  SECTION("stream"){
+    std::stringstream ss(content);
+    check_rows(quoted_iterator(ss));
+  }
+
+  SECTION("block reader splitting quoted fields"){
+    for(std::size_t block : {1, 5, 16, 64, 1000}){
+      std::stringstream ss(content);
+      block_reader reader(ss, block);
+      check_rows(quoted_iterator(reader));
+    }
+  }
+
+  SECTION("prefetch reader splitting quoted fields"){
+    for(std::size_t buffer_size : {1, 5, 16, 64, 1000}){
+      std::stringstream ss(content);
+      prefetch_reader reader(ss, 2, buffer_size);
+      check_rows(quoted_iterator(reader));
+    }
+  }
+
+  SECTION("views without escaped quotes point into the buffer"){
+    quoted_iterator it(sv{content});
+    CHECK((*it)[1].data() == content.data() + 7);
+  }
+
+  SECTION("copies keep unescaped fields valid"){
+    quoted_iterator it(sv{content});
+    auto copy = std::make_unique<quoted_iterator>(it);
+    it = quoted_iterator{};
+    CHECK((**copy)[2] == "with \"escaped\" quotes");
+  }
+
+  SECTION("malformed quoting is detected in checked mode"){
+    CHECK_THROWS_AS(quoted_iterator(sv{"a,\"b,c\n"}), csv_error);
+    CHECK_THROWS_AS(quoted_iterator(sv{"a,\"b\"c\",d\n"}), csv_error);
+    CHECK_THROWS_AS(quoted_iterator(sv{"a,\"b\"x,d\n"}), csv_error);
+  }
+
+  SECTION("quotes are plain characters without the option"){
+    CHECK(*csv_iterator<2>(sv{"\"a,b\""}) == std::array{sv{"\"a"}, sv{"b\""}});
+  }
+}
+
+TEST_CASE("Column projection"){
+  using sv = std::string_view;
+  std::string wide_line;
+  for(int i = 0; i < 40; ++i) wide_line += (i ? "," : "") + std::to_string(i);
+  std::string content = wide_line + "\n" + wide_line + ",surplus\n";
+
+  SECTION("only selected fields are returned"){
+    csv_iterator<40, false, columns<7, 3>> it(sv{content});
+    CHECK(std::is_same_v<decltype(it)::value_type, std::array<sv, 2>>);
+    CHECK(*it == std::array{sv{"7"}, sv{"3"}});
+    ++it;
+    CHECK(*it == std::array{sv{"7"}, sv{"3"}});
+    CHECK(++it == decltype(it){});
+  }
+
+  SECTION("last column keeps surplus fields in unchecked mode"){
+    csv_iterator<40, false, columns<39, 0>> it(sv{content});
+    ++it;
+    CHECK(*it == std::array{sv{"39,surplus"}, sv{"0"}});
+  }
+
+  SECTION("short lines give empty fields in unchecked mode"){
+    csv_iterator<5, false, columns<3, 1>> it(sv{"a,b\n0,1,2,3,4\n"});
+    CHECK(*it == std::array{sv{""}, sv{"b"}});
+    CHECK(*++it == std::array{sv{"3"}, sv{"1"}});
+  }
+
+  SECTION("checked mode still validates whole line"){
+    csv_iterator<40, true, columns<1>> it(sv{content});
+    CHECK((*it)[0] == "1");
+    CHECK_THROWS_AS(++it, csv_error);
+  }
+
+  SECTION("works with quoting and streams"){
+    std::stringstream ss("\"a,\"\"b\",c,\"d\nd\"\n1,2,3\n");
+    csv_iterator<3, true, rfc4180, columns<2, 0>> it(ss);
+    CHECK(*it == std::array{sv{"d\nd"}, sv{"a,\"b"}});
+    CHECK(*++it == std::array{sv{"3"}, sv{"1"}});
+  }
+
+  SECTION("block parser holds selected columns"){
+    block_parser<40, false, columns<5>> parser(sv{content});
+    row_block<1> block;
+    CHECK(parser.next(block) == 2);
+    CHECK(block.field(1, 0) == "5");
+
+    std::string two_lines = wide_line + "\n" + wide_line;
+    block_parser<40, true, columns<7, 3>> unordered(sv{two_lines});
+    row_block<2> unordered_block;
+    CHECK(unordered.next(unordered_block) == 2);
+    CHECK(unordered_block.base() == unordered_block.field(0, 1).data());
+    CHECK(unordered_block.offsets(1)[0] == 0);
+    CHECK(unordered_block.field(1, 0) == "7");
+    CHECK(unordered_block.field(1, 1) == "3");
+  }
+}
+
+TEST_CASE("Dynamic width"){
+  using sv = std::string_view;
+  using fields = std::vector<sv>;
+  auto to_fields = [](const row_view& row){ return fields(row.begin(), row.end()); };
+
+  SECTION("width is taken from the first line"){
+    std::string content = "a,b,c\n1,2,3\n4,5,6";
+    csv_iterator<dynamic_width> it(sv{content});
+    CHECK(std::is_same_v<decltype(it)::value_type, row_view>);
+    CHECK(it.width() == 3);
+    CHECK(to_fields(*it) == fields{"a", "b", "c"});
+    auto* storage = it->data();
+    CHECK(to_fields(*++it) == fields{"1", "2", "3"});
+    CHECK(to_fields(*++it) == fields{"4", "5", "6"});
+    CHECK(it->data() == storage);
+    CHECK(++it == decltype(it){});
+  }
+
+  SECTION("width can be given"){
+    csv_iterator<dynamic_width> it(sv{"1,2,3,4\n5\n"}, ',', 2);
+    CHECK(to_fields(*it) == fields{"1", "2,3,4"});
+    CHECK(to_fields(*++it) == fields{"5", ""});
+    CHECK_THROWS_AS((csv_iterator<2>(sv{"1,2"}, ',', 3)), std::invalid_argument);
+  }
+
+  SECTION("checked mode validates width"){
+    std::stringstream ss("1;2\n3;4\n5;6;7\n");
+    csv_iterator<dynamic_width, true> it(ss, ';');
+    CHECK(to_fields(*++it) == fields{"3", "4"});
+    CHECK_THROWS_AS(++it, csv_error);
+    using checked = csv_iterator<dynamic_width, true>;
+    CHECK_THROWS_AS(checked(sv{"1,2"}, ',', 3), csv_error);
+  }
+
+  SECTION("copies own their fields"){
+    std::stringstream ss("\"a\"\"\",b\nc,d\n");
+    csv_iterator<dynamic_width, false, rfc4180> it(ss);
+    auto copy = it;
+    ++it;
+    CHECK(to_fields(*copy) == fields{"a\"", "b"});
+    CHECK(to_fields(*it) == fields{"c", "d"});
+  }
+
+  SECTION("quoted first line split by reader"){
+    std::stringstream ss("\"x\ny\",z,w\n1,2,3\n");
+    block_reader reader(ss, 4);
+    csv_iterator<dynamic_width, true, rfc4180> it(reader);
+    CHECK(to_fields(*it) == fields{"x\ny", "z", "w"});
+    CHECK(to_fields(*++it) == fields{"1", "2", "3"});
+  }
+}
+
+TEST_CASE("Typed rows"){
+  using sv = std::string_view;
+  using row = std::tuple<std::int64_t, double, sv, bool>;
+
+  SECTION("fields are converted to column types"){
+    std::stringstream ss("1,2.5,abc,true\n-42,1e3,,0\n");
+    csv_typed_iterator<row, true> it(ss);
+    CHECK(*it == row{1, 2.5, "abc", true});
+    auto copy = it;
+    CHECK(std::get<2>(*copy) == "abc");
+    ++it;
+    auto& [integer, floating, text, flag] = *it;
+    CHECK(integer == -42);
+    CHECK(floating == 1000.0);
+    CHECK(text.empty());
+    CHECK(flag == false);
+    CHECK(++it == csv_typed_iterator<row, true>{});
+  }
+
+  SECTION("works with options and other sources"){
+    using quoted_row = std::tuple<sv, unsigned>;
+    std::string content = "\"a,b\",7\n";
+    CHECK(*csv_typed_iterator<quoted_row, true, rfc4180>(sv{content}) == quoted_row{"a,b", 7});
+    CHECK(std::distance(csv_typed_iterator<quoted_row>(sv{content}), csv_typed_iterator<quoted_row>{}) == 1);
+  }
+
+  SECTION("conversion errors are reported in checked mode"){
+    using checked = csv_typed_iterator<std::tuple<int, int>, true>;
+    CHECK_THROWS_AS(checked(sv{"1,x\n"}), csv_error);
+    CHECK_THROWS_AS(checked(sv{"1,2x\n"}), csv_error);
+    CHECK_THROWS_AS(checked(sv{"1,99999999999\n"}), csv_error);
+    CHECK_NOTHROW(csv_typed_iterator<std::tuple<int, int>>(sv{"1,x\n"}));
+  }
+
+  SECTION("rows that cannot be converted follow the error policy"){
+    std::string content = "1,2\n3,x\n4,5\n";
+    csv_typed_iterator<std::tuple<int, int>, true, skip_errors> skipping(sv{content});
+    CHECK(*skipping == std::tuple{1, 2});
+    CHECK(*++skipping == std::tuple{4, 5});
+    CHECK(skipping.errors().count == 1);
+    CHECK(skipping.errors().last.code == errc::invalid_field);
+    CHECK(skipping.errors().last.line == 2);
+    CHECK(skipping.errors().last.offset == 4);
+
+    std::vector<parse_error> errors;
+    std::stringstream ss("x,1\n2,3\n");
+    csv_typed_iterator<std::tuple<int, int>, true, report_errors> reporting(ss, ',', [&errors](const parse_error& error){
+      errors.push_back(error);
+    });
+    CHECK(*reporting == std::tuple{2, 3});
+    REQUIRE(errors.size() == 1);
+    CHECK(errors[0].code == errc::invalid_field);
+    CHECK(errors[0].line == 1);
+    CHECK(errors[0].offset == 0);
+  }
+}
+
+TEST_CASE("Columnar row blocks"){
+  using sv = std::string_view;
+  std::string content;
+  for(int i = 0; i < 10; ++i) content += std::to_string(i) + ";" + std::to_string(i * 1.5) + ";name" + std::to_string(i) + "\n";
+
+  block_parser<3, true> parser(sv{content}, ';');
+  row_block<3> block(4);
+  std::vector<int> integers;
+  std::vector<double> doubles;
+  std::vector<std::size_t> sizes;
+  int row = 0;
+  while(parser.next(block) != 0){
+    sizes.push_back(block.size());
+    CHECK(block.convert(0, integers));
+    CHECK(block.convert(1, doubles));
+    CHECK_FALSE(block.convert(2, integers));
+    for(std::size_t i = 0; i < block.size(); ++i, ++row){
+      CHECK(doubles[i] == row * 1.5);
+      CHECK(block.field(i, 2) == "name" + std::to_string(row));
+      CHECK(sv(block.base() + block.offsets(0)[i], block.lengths(0)[i]) == std::to_string(row));
+    }
+  }
+
+  CHECK(row == 10);
+  CHECK(sizes == std::vector<std::size_t>{4, 4, 2});
+  CHECK(parser.next(block) == 0);
+  CHECK(block.empty());
+}
+
+TEST_CASE("Row index"){
+  using sv = std::string_view;
+  std::string content;
+  for(int i = 0; i < 1000; ++i) content += std::to_string(i) + "," + std::string(i % 7, 'z') + "\n";
+  content += "1000,unterminated";
+
+  row_index index(64);
+  index.update(content);
+  CHECK(index.rows() == 1000);
+  CHECK(index.indexed_bytes() == content.rfind('\n') + 1);
+
+  SECTION("seeking to any row"){
+    for(std::size_t row : {0, 1, 63, 64, 65, 500, 999}){
+      CHECK((*csv_iterator<2>(index.seek(content, row)))[0] == std::to_string(row));
+    }
+    CHECK(index.seek(content, 1000) == "1000,unterminated");
+    CHECK_THROWS_AS(index.seek(content, 1001), std::out_of_range);
+  }
+
+  SECTION("split points cover whole rows"){
+    auto points = index.split_points(4);
+    CHECK(points.size() == 5);
+    CHECK(points.front() == 0);
+    CHECK(points.back() == index.indexed_bytes());
+    std::size_t rows = 0;
+    for(std::size_t i = 0; i + 1 < points.size(); ++i){
+      CHECK(content[points[i + 1] - 1] == '\n');
+      rows += std::distance(csv_iterator<2, true>(sv{content}.substr(points[i], points[i + 1] - points[i])), csv_iterator<2, true>{});
+    }
+    CHECK(rows == 1000);
+  }
+
+  SECTION("persisted index is updated with appended content"){
+    std::string path = "csv_iterator_row_index_test.idx";
+    index.save(path);
+    auto loaded = row_index::load(path);
+    std::remove(path.c_str());
+
+    content += "\n1001,x\n";
+    loaded.update(content);
+    CHECK(loaded.rows() == 1002);
+    CHECK(loaded.sampling() == 64);
+    CHECK((*csv_iterator<2>(loaded.seek(content, 1001)))[0] == "1001");
+    CHECK((*csv_iterator<2>(loaded.seek(content, 640)))[0] == "640");
+
+    CHECK_THROWS_AS(row_index::load(path), csv_error);
+  }
+}
+
+TEST_CASE("Parallel parsing"){
+  using sv = std::string_view;
+  std::string content;
+  for(int i = 0; i < 5000; ++i){
+    content += std::to_string(i) + "," + std::string(i % 17, 'x') + "\n";
+  }
+
+  SECTION("unordered mode visits every row exactly once"){
+    std::vector<std::atomic<int>> visits(5000);
+    std::atomic<bool> fields_correct{true};
+    parallel_for_each<2, true>(sv{content}, [&](const std::array<sv, 2>& row){
+      auto index = std::stoul(std::string(row[0]));
+      visits[index]++;
+      if(row[1].size() != index % 17) fields_correct = false;
+    }, ',', 4, 1000);
+    CHECK(std::all_of(visits.begin(), visits.end(), [](auto& count){ return count == 1; }));
+    CHECK(fields_correct);
+  }
+
+  SECTION("batches consist of whole rows"){
+    std::atomic<std::size_t> rows{0};
+    parallel_for_each_batch<2>(sv{content}, [&](csv_iterator<2> batch){
+      rows += std::distance(batch, csv_iterator<2>{});
+    }, ',', 3, 777);
+    CHECK(rows == 5000);
+  }
+
+  SECTION("ordered mode delivers rows in file order"){
+    int expected = 0;
+    parallel_for_each_ordered<2>(sv{content}, [&](const std::array<sv, 2>& row){
+      CHECK(row[0] == std::to_string(expected++));
+    }, ',', 4, 512);
+    CHECK(expected == 5000);
+  }
+
+  SECTION("rows of dynamic width are parsed unordered"){
+    std::atomic<std::size_t> rows{0};
+    std::atomic<bool> fields_correct{true};
+    parallel_for_each<dynamic_width, true>(sv{content}, [&](const row_view& row){
+      ++rows;
+      if(row.size() != 2 || row[1].size() != std::stoul(std::string(row[0])) % 17) fields_correct = false;
+    }, ',', 4, 1000);
+    CHECK(rows == 5000);
+    CHECK(fields_correct);
+  }
+
+  SECTION("zero chunk size is treated as one byte"){
+    std::atomic<int> rows{0};
+    parallel_for_each<2>(sv{"a,b\nc,d\n"}, [&](const std::array<sv, 2>&){ ++rows; }, ',', 2, 0);
+    CHECK(rows == 2);
+    int ordered = 0;
+    parallel_for_each_ordered<2>(sv{"a,b\nc,d\n"}, [&](const std::array<sv, 2>&){ ++ordered; }, ',', 2, 0);
+    CHECK(ordered == 2);
+  }
+
+  SECTION("errors are propagated to the caller"){
+    content += "1,2,3\n";
+    auto noop = [](const std::array<sv, 2>&){};
+    CHECK_THROWS_AS((parallel_for_each<2, true>(sv{content}, noop, ',', 4, 1000)), csv_error);
+    CHECK_THROWS_AS((parallel_for_each_ordered<2, true>(sv{content}, noop, ',', 4, 1000)), csv_error);
+  }
+}
+
+TEST_CASE("Parse statistics"){
+  using sv = std::string_view;
+  std::string content = "1,22\n333,4\n5,6";
+
+  SECTION("are not collected by default"){
+    CHECK(sizeof(csv_iterator<2>) < sizeof(csv_iterator<2, false, collect_statistics>));
+  }
+
+  SECTION("contiguous buffer"){
+    csv_iterator<2, true, collect_statistics> it(sv{content});
+    while(it != decltype(it){}) ++it;
+    auto& statistics = it.statistics();
+    CHECK(statistics.rows == 3);
+    CHECK(statistics.bytes == content.size());
+    CHECK(statistics.delimiters == 3);
+    CHECK(statistics.longest_line == 5);
+    CHECK(statistics.check_failures == 0);
+    CHECK(statistics.io_time.count() == 0);
+  }
+
+  SECTION("stream and copies"){
+    std::stringstream ss(content + "\n");
+    csv_iterator<2, false, collect_statistics> it(ss);
+    auto copy = it;
+    CHECK(*copy == std::array{sv{"1"}, sv{"22"}});
+    CHECK(copy.statistics().rows == 1);
+    while(it != decltype(it){}) ++it;
+    CHECK(it.statistics().rows == 3);
+    CHECK(it.statistics().bytes == content.size() + 1);
+    CHECK(it.statistics().io_time.count() > 0);
+  }
+
+  SECTION("readers and quoted lines carried over"){
+    std::stringstream ss("\"a\nb\",c\n" + content);
+    block_reader reader(ss, 4);
+    csv_iterator<2, true, rfc4180, collect_statistics> it(reader);
+    CHECK(*it == std::array{sv{"a\nb"}, sv{"c"}});
+    while(it != decltype(it){}) ++it;
+    CHECK(it.statistics().rows == 4);
+    CHECK(it.statistics().bytes == content.size() + 8);
+  }
+
+  SECTION("check failures"){
+    csv_iterator<2, true, collect_statistics> it(sv{"1,2\n3\n"});
+    CHECK_THROWS_AS(++it, csv_error);
+    CHECK(it.statistics().check_failures == 1);
+    CHECK(it.statistics().rows == 1);
+  }
+}
+
+TEST_CASE("Skipping malformed lines"){
+  using sv = std::string_view;
+  std::string content = "a,b\n1,2,3\nc,\"d\"\n\"e\"f\"\",g\nh\nx,\"i\n";
+
+  SECTION("error codes"){
+    std::error_code code = errc::unescaped_quote;
+    CHECK(code.category().name() == sv{"csv"});
+    CHECK(code.message() == "csv file contains unescaped quote in quoted field.");
+    CHECK(code != std::error_code{});
+  }
+
+  SECTION("skipped lines are counted"){
+    csv_iterator<2, true, rfc4180, skip_errors> it(sv{content});
+    CHECK(*it == std::array{sv{"a"}, sv{"b"}});
+    CHECK(*++it == std::array{sv{"c"}, sv{"d"}});
+    CHECK(it.errors().count == 1);
+    CHECK(it.errors().last.code == errc::wrong_number_of_columns);
+    CHECK(it.errors().last.line == 2);
+    CHECK(it.errors().last.offset == 4);
+    CHECK(++it == decltype(it){});
+    CHECK(it.errors().count == 4);
+    CHECK(it.errors().last.code == errc::unterminated_quoted_field);
+    CHECK(it.errors().last.line == 6);
+    CHECK(it.errors().last.offset == content.rfind('x'));
+  }
+
+  SECTION("skipped lines are reported"){
+    std::vector<parse_error> errors;
+    auto collect = [&errors](const parse_error& error){ errors.push_back(error); };
+    std::stringstream ss(content);
+    block_reader reader(ss, 5);
+    std::size_t rows = 0;
+    for(csv_iterator<2, true, rfc4180, report_errors> it(reader, ',', collect); it != decltype(it){}; ++it) ++rows;
+    CHECK(rows == 2);
+    REQUIRE(errors.size() == 4);
+    CHECK(errors[1].code == errc::unescaped_quote);
+    CHECK(errors[1].line == 4);
+    CHECK(errors[1].offset == content.find("\"e"));
+    CHECK(errors[2].line == 5);
+    CHECK(errors[2].offset == content.find('h'));
+  }
+
+  SECTION("dynamic width and streams"){
+    std::size_t reported = 0;
+    std::stringstream ss("1;2\n3\n4;5\n");
+    csv_iterator<dynamic_width, true, report_errors> it(ss, ';', [&reported](const parse_error& error){
+      reported += error.line == 2 && error.offset == 4;
+    });
+    CHECK(std::distance(it, decltype(it){}) == 2);
+    CHECK(reported == 1);
+  }
+
+  SECTION("handler after the number of columns"){
+    std::size_t reported = 0;
+    csv_iterator<2, true, report_errors> it(sv{"1\n2,3\n"}, ',', 2, [&reported](const parse_error&){ ++reported; });
+    CHECK(*it == std::array{sv{"2"}, sv{"3"}});
+    CHECK(reported == 1);
+  }
+}
+
+TEST_CASE("Writing csv"){
+  using sv = std::string_view;
+
+  SECTION("fields are quoted only when needed"){
+    std::stringstream ss;
+    {
+      csv_writer<3> writer(ss);
+      writer.write(std::array{sv{"plain"}, sv{"a,b"}, sv{"say \"hi\""}});
+      writer.write(std::array{sv{""}, sv{"line\nbreak"}, sv{"cr\r"}});
+      writer.write(std::array{sv{"0123456789abcdef"}, sv{"0123456789abcdef,"}, sv{"0123456789\nabcdef"}});
+      CHECK(ss.str().empty());
+    }
+    CHECK(ss.str() == "plain,\"a,b\",\"say \"\"hi\"\"\"\n,\"line\nbreak\",\"cr\r\"\n"
+                      "0123456789abcdef,\"0123456789abcdef,\",\"0123456789\nabcdef\"\n");
+
+    std::string written = ss.str();
+    csv_iterator<3, true, rfc4180> it(sv{written});
+    CHECK(*it == std::array{sv{"plain"}, sv{"a,b"}, sv{"say \"hi\""}});
+    CHECK(*++it == std::array{sv{""}, sv{"line\nbreak"}, sv{"cr\r"}});
+  }
+
+  SECTION("typed rows round trip"){
+    using row = std::tuple<std::int64_t, double, bool, std::string>;
+    std::vector<row> rows;
+    for(int i = 0; i < 1000; ++i) rows.emplace_back(i * -7919, i / 7.0, i % 2, "name;" + std::to_string(i));
+
+    std::stringstream ss;
+    csv_writer<4> writer(ss, ';', 100);
+    for(auto& written : rows) writer.write(written);
+    writer.flush();
+
+    std::size_t read = 0;
+    for(auto& [id, value, flag, name] : csv_typed_iterator<std::tuple<std::int64_t, double, bool, sv>, true, rfc4180>(ss, ';')){
+      auto& expected = rows[read++];
+      CHECK(id == std::get<0>(expected));
+      CHECK(value == std::get<1>(expected));
+      CHECK(flag == std::get<2>(expected));
+      CHECK(name == std::get<3>(expected));
+    }
+    CHECK(read == rows.size());
+  }
+
+#ifdef CSV_ITERATOR_HAS_POSIX
+  SECTION("file descriptor and fields longer than the buffer"){
+    std::FILE* file = std::tmpfile();
+    REQUIRE(file);
+    std::string long_field(1000, 'x');
+    {
+      csv_writer<2> writer(fileno(file), ',', 16);
+      int id = 5;
+      writer.write(std::tie(id, long_field));
+      writer.write(std::make_tuple(sv{"a"}, 1.5f));
+    }
+    std::rewind(file);
+    std::string content(2000, '\0');
+    content.resize(std::fread(content.data(), 1, content.size(), file));
+    std::fclose(file);
+    CHECK(content == "5," + long_field + "\na,1.5\n");
+  }
+#endif
+}
+
+TEST_CASE("Writing csv after failures"){
+  using sv = std::string_view;
+  std::string field(1000, 'x');
+
+#ifdef CSV_ITERATOR_HAS_POSIX
+  SECTION("file descriptor keeps the unwritten rest"){
+    int pipe_fds[2];
+    REQUIRE(::pipe(pipe_fds) == 0);
+    ::fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(pipe_fds[1], F_SETFL, O_NONBLOCK);
+    const std::size_t rows = 1000;
+    {
+      csv_writer<1> writer(pipe_fds[1], ',', 1 << 20);
+      // more than a pipe can hold
+      for(std::size_t i = 0; i < rows; ++i) writer.write(std::array{sv{field}});
+      CHECK_THROWS_AS(writer.flush(), std::system_error);
+
+      std::string read;
+      char chunk[4096];
+      for(;;){
+        ssize_t result = ::read(pipe_fds[0], chunk, sizeof(chunk));
+        if(result > 0) read.append(chunk, static_cast<std::size_t>(result));
+        if(result < static_cast<ssize_t>(sizeof(chunk))){
+          try {
+            writer.flush();
+            break;
+          } catch(const std::system_error&) {
+          }
+        }
+      }
+      ::close(pipe_fds[1]);
+      for(ssize_t result; (result = ::read(pipe_fds[0], chunk, sizeof(chunk))) > 0;) read.append(chunk, static_cast<std::size_t>(result));
+      CHECK(read.size() == rows * (field.size() + 1));
+      CHECK(static_cast<std::size_t>(std::count(read.begin(), read.end(), '\n')) == rows);
+    }
+    ::close(pipe_fds[0]);
+  }
+#endif
+
+  SECTION("streams drop the buffer"){
+    std::stringstream ss;
+    csv_writer<1> writer(ss);
+    writer.write(std::array{sv{"a"}});
+    ss.setstate(std::ios::badbit);
+    CHECK_THROWS_AS(writer.flush(), csv_error);
+    ss.clear();
+    writer.write(std::array{sv{"b"}});
+    writer.flush();
+    CHECK(ss.str() == "b\n");
+  }
+}
+
 TEST_CASE("Parsing stream errors"){
+  using sv = std::string_view;
+
+  SECTION("too many fields are detected in checked mode"){
+    std::stringstream ss("1,2,3\n1,2,3,4,5,6\n");
+    csv_iterator<3, true> it(ss);
+    CHECK_THROWS_AS(++it, csv_error);
+    using single_column = csv_iterator<1, true>;
+    single_column it2(sv{"a\nb,c"});
+    CHECK_THROWS_AS(++it2, csv_error);
+  }
 
+  SECTION("too few fields are detected in checked mode"){
+    std::stringstream ss("1,2,3\n1,2\n");
+    csv_iterator<3, true> it(ss);
+    CHECK_THROWS_AS(++it, csv_error);
+    using three_columns = csv_iterator<3, true>;
+    CHECK_THROWS_AS(three_columns(sv{"1,2\n"}), csv_error);
+  }
+
+  SECTION("unchecked mode keeps surplus fields in the last one"){
+    CHECK(*csv_iterator<2>(sv{"1,2,3\n"}) == std::array{sv{"1"}, sv{"2,3"}});
+  }
 }